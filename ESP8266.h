@@ -27,6 +27,22 @@
 //	Enable the DebugSerial to uncomment the following.
 //#define ESP8266_USE_DEBUGSERIAL
 
+//	Whether to enable the metrics of the commands and the transmission.
+//	Enable the stats and the resetStats to uncomment the following.
+//#define ESP8266_USE_METRICS
+
+//	Whether to pool the connections by the destination for the reuse.
+//	Enable the acquire and the release to uncomment the following.
+//#define ESP8266_USE_POOL
+
+//	Whether to cache the address of the host resolved by ESP8266.
+//	Enable the resolve, the invalidate and the dnsStat to uncomment the following.
+//#define ESP8266_USE_DNSCACHE
+
+//	Whether to instantiate the driver over ESP8266Trace and ESP8266Replay.
+//	Enable the trace capture and the replay to uncomment the following.
+//#define ESP8266_USE_TRACE
+
 
 #include "Arduino.h"
 #if defined(ESP8266_USE_SOFTWARESERIAL) || defined(ESP8266_USE_DEBUGSERIAL)
@@ -47,6 +63,8 @@ typedef	SoftwareSerial	_ESP8266_SERIAL_TYPE;
 // Default baudrate for communication between ESP8266 and an arduino
 // SoftwareSerial baudrate works fine up to 9600 as recommended at uno.
 #define ESP8266_DEF_BAUDRATE	9600
+// Upper limit of the baud rate negotiation
+#define ESP8266_BAUD_MAX		57600
 #else
 
 // Directives at using hardware serial
@@ -58,6 +76,8 @@ typedef HardwareSerial	_ESP8266_SERIAL_TYPE;
 #define _ESP8266_SERIAL			Serial
 // Default baudrate for communication between ESP8266 and an arduino
 #define ESP8266_DEF_BAUDRATE	115200
+// Upper limit of the baud rate negotiation
+#define ESP8266_BAUD_MAX		921600
 #endif
 
 // Declarations for applying the DebugSerial
@@ -81,12 +101,22 @@ typedef enum {
 	WIFI_RESET_SOFT							// Use AT+RST command
 } WIFI_RESET;
 
+// Hardware flow control
+// RTS/CTS flow control is enabled by defining the pins below.
+// ESP8266_RTS_PIN is the arduino output wired to CTS (GPIO13) of ESP8266,
+// the driver drives it HIGH to pause the module. ESP8266_CTS_PIN is the
+// arduino input wired to RTS (GPIO15) of ESP8266, the driver holds the
+// writing while it is HIGH.
+//#define ESP8266_RTS_PIN		4
+//#define ESP8266_CTS_PIN		5
+
 // Declaration of constants
 // Time-out limit for the waiting reply from ESP8266
 #define ESP8266_DEF_TIMEOUT		3000
 // Enumerator for the AT command to drive the ESP8266
 // Error condition identifiers
 typedef enum {
+	WIFI_ERR_PENDING = -2,					// Command is in progress
 	WIFI_ERR_TIMEOUT = -1,					// Time-out occurred at listen from serial
 	WIFI_ERR_OK = 0,						// Command successful
 	WIFI_ERR_ERROR = 1,						// Command error
@@ -94,7 +124,9 @@ typedef enum {
 	WIFI_ERR_SENDOK,						// Send successful
 	WIFI_ERR_BUSY,							// Transmission busy
 	WIFI_ERR_SENDFAIL,						// Sending failed
-	WIFI_ERR_CLOSED							// IP connection has been closed
+	WIFI_ERR_CLOSED,						// IP connection has been closed
+	WIFI_ERR_PROMPT,						// Ready to accept the sending data
+	WIFI_ERR_IPD							// Received data frame arrived
 } WIFI_ERR;
 // An activity to intended of the ESP8266 operation
 typedef enum {								// WiFi mode for AT+CWMODE
@@ -136,37 +168,691 @@ typedef enum {								// Return enumeration from AT+CIPSTATUS
 	WIFI_STATUS_UNKNOWN
 } WIFI_STATUS;
 
+// Asynchronous command handling
+// The handle identifies the command issued by the asynchronous methods.
+// A negative handle indicates that the command could not be issued
+// because the preceding command is still in progress.
+typedef int8_t	WIFI_HANDLE;
+#define WIFI_HANDLE_NONE		-1
+// Completion notification of the asynchronous command.
+typedef void (*WIFI_CALLBACK)(WIFI_HANDLE handle, WIFI_ERR err);
+// AT command identifiers for the asynchronous command
+typedef enum {
+	WIFI_CMD_GENERIC,						// Result code only
+	WIFI_CMD_CWMODE,						// AT+CWMODE
+	WIFI_CMD_CIPMUX,						// AT+CIPMUX
+	WIFI_CMD_CIPMODE,						// AT+CIPMODE
+	WIFI_CMD_CWJAP,							// AT+CWJAP
+	WIFI_CMD_CWQAP,							// AT+CWQAP
+	WIFI_CMD_CIPSTART,						// AT+CIPSTART
+	WIFI_CMD_CIPSERVER,						// AT+CIPSERVER
+	WIFI_CMD_CIPSEND,						// AT+CIPSEND
+	WIFI_CMD_CIPCLOSE,						// AT+CIPCLOSE
+	WIFI_CMD_RST,							// Module restart until "ready"
+	WIFI_CMD_CIFSR,							// AT+CIFSR
+	WIFI_CMD_CWJAPQ,						// AT+CWJAP?
+	WIFI_CMD_CIPSTATUS,						// AT+CIPSTATUS
+	WIFI_CMD_CIPDOMAIN,						// AT+CIPDOMAIN
+	WIFI_CMD_CIPSTO,						// AT+CIPSTO
+	WIFI_CMD_CIPDINFO,						// AT+CIPDINFO
+	WIFI_CMD_CIPRECVDATA,					// AT+CIPRECVDATA
+	WIFI_CMD_CWLAP,							// AT+CWLAP
+	WIFI_CMD_END							// Number of the commands
+} WIFI_CMD;
+// Progress of the asynchronous command
+typedef enum {
+	WIFI_CMDST_IDLE,						// No command issued
+	WIFI_CMDST_RESPONSE,					// Waiting for the result code
+	WIFI_CMDST_PROMPT,						// Waiting for the prompt of CIPSEND
+	WIFI_CMDST_SENDOK,						// Waiting for the sending conclusion
+	WIFI_CMDST_DONE							// Completed
+} WIFI_CMDST;
+// Segment of the sending data for the gather transmission.
+// The data of the segment can be placed in the program memory
+// by PROGMEM, in that case the progmem member should be true.
+typedef struct {
+	const void		*data;					// Head of the data
+	uint16_t		length;					// Length of the data
+	bool			progmem;				// The data is in PROGMEM
+} WIFI_SEGMENT;
+// Maximum length of the data to be sent by one CIPSEND
+#define ESP8266_SEND_MAX		2048
+// Large transmission
+// The stream longer than ESP8266_SEND_MAX is split into the segments of
+// ESP8266_SEND_MAX, and each segment is sent by one CIPSEND.
+// Producer of the stream, it fills the buffer up to the size with the data
+// from the offset of the stream, and returns the filled length.
+typedef uint16_t (*WIFI_PRODUCER)(uint8_t *buffer, uint16_t size, uint32_t offset);
+// Progress notification at the every conclusion of the segment
+typedef void (*WIFI_PROGRESS)(uint32_t sent, uint32_t total);
+// Source of the stream being sent
+typedef struct {
+	WIFI_PRODUCER	producer;				// Producer, NULL if not used
+	Stream			*source;				// Source stream, NULL if not used
+	const WIFI_SEGMENT	*segment;			// Current segment of the gather source
+	uint8_t			segments;				// Remaining segments
+	uint16_t		offset;					// Offset in the current segment
+	uint32_t		written;				// Bytes written out to ESP8266
+	bool			underrun;				// The source ran dry before the length
+} WIFI_STREAM;
+// Result of the last large transmission
+typedef struct {
+	uint32_t		sent;					// Bytes acknowledged by SEND OK
+	uint32_t		total;					// Bytes requested
+	uint16_t		segments;				// Number of CIPSEND issued
+	uint32_t		elapsed;				// Elapsed time in milliseconds
+	uint32_t		throughput;				// Bytes per second
+} WIFI_STREAMSTAT;
+
+// Asynchronous command slot
+typedef struct {
+	WIFI_HANDLE		handle;					// Handle of this command
+	WIFI_CMD		cmd;					// Issued AT command
+	WIFI_CMDST		state;					// Progress
+	WIFI_ERR		result;					// Intermediate or concluded condition
+	uint32_t		startAt;				// Time of the current step started
+	uint32_t		timeOut;				// Time-out of each step
+	const WIFI_SEGMENT	*segment;			// Sending data at the prompt
+	uint8_t			segments;				// Number of the sending segments
+	WIFI_SEGMENT	single;					// Segment for the contiguous data
+	WIFI_CALLBACK	callback;				// Completion notification
+	void			*reply;					// Destination of the information response
+	int8_t			channel;				// Connection ID of CIPSTART and CIPCLOSE, -1 without
+#ifdef ESP8266_USE_METRICS
+	uint32_t		issuedAt;				// Time of the command issued
+#endif
+} WIFI_CMDSLOT;
+// Number of the command slots, it bounds the pipeline depth.
+// The slot keeps the result of the concluded command until reused.
+// The sizes below can be defined ahead, AVR takes the smaller defaults
+// for its RAM.
+#ifndef ESP8266_CMD_SLOTS
+#ifdef __AVR__
+#define ESP8266_CMD_SLOTS		2
+#else
+#define ESP8266_CMD_SLOTS		4
+#endif
+#endif
+// Default pipeline depth, 1 waits for each reply before the next command.
+#define ESP8266_CMD_DEPTH		1
+// Pipeline depth of the setup commands by config. They are idempotent,
+// so the command answered busy is issued again.
+#define ESP8266_SETUP_DEPTH		2
+// Buffer size of the command line assembled on the stack. The line is
+// written out at once, the longer line is written out in pieces.
+#ifndef ESP8266_CMDLINE_SIZE
+#ifdef __AVR__
+#define ESP8266_CMDLINE_SIZE	32
+#else
+#define ESP8266_CMDLINE_SIZE	64
+#endif
+#endif
+
+// Response line framing
+// The response is framed by the line. The information lines are taken
+// by the command in progress, and the rest are handed to the notice
+// handler as unsolicited lines such as "0,CONNECT".
+// Maximum length of the line to be parsed, the excess is truncated.
+// +CWJAP reply with SSID of 32 characters and BSSID fits in it.
+#define ESP8266_LINE_SIZE		72
+// Buffer size of SSID including the terminator
+#define ESP8266_SSID_SIZE		33
+// Time-out of the module restart until "ready" with millisecond unit
+#define ESP8266_RESET_TIMEOUT	5000
+// Notification of the unsolicited line
+typedef void (*WIFI_NOTICE)(const char *line);
+
+// Receiving data demultiplexer
+// Received data by +IPD would be stored to the buffer that is prepared
+// for each connection ID. The single connection uses the buffer of ID 0.
+// Number of connection IDs to be received
+#define ESP8266_RX_CHANNELS		5
+// Receiving buffer size for each connection ID, up to 255.
+// The data which overflows from the buffer would be discarded.
+#ifndef ESP8266_RX_BUFF_SIZE
+#ifdef __AVR__
+#define ESP8266_RX_BUFF_SIZE	32
+#else
+#define ESP8266_RX_BUFF_SIZE	64
+#endif
+#endif
+// Number of bytes drained from the serial at once. The payload of +IPD
+// in the batch is copied to the receiving buffer as a block.
+#ifndef ESP8266_RX_BATCH
+#ifdef __AVR__
+#define ESP8266_RX_BATCH		16
+#else
+#define ESP8266_RX_BATCH		32
+#endif
+#endif
+// Number of +IPD frames whose boundary is kept for each connection ID.
+// On the stream, the frame beyond it is merged into the last one. On
+// the datagram, the datagram beyond it is discarded, and the datagram
+// which exceeds the receiving buffer is truncated to it.
+#ifndef ESP8266_RX_FRAMES
+#define ESP8266_RX_FRAMES		2
+#endif
+// Passive receive mode
+// With AT+CIPRECVMODE=1, ESP8266 holds the received data and announces
+// its length by +IPD without the data. receive pulls the data by
+// AT+CIPRECVDATA up to the following at once, directly to the buffer.
+#define ESP8266_PULL_MAX		2048
+// Boundary and the remote end of the received frame
+typedef struct {
+	uint16_t	length;						// Unread length of the frame
+	uint8_t		ip[4];						// Remote address by AT+CIPDINFO=1
+	uint16_t	port;						// Remote port by AT+CIPDINFO=1
+} WIFI_FRAME;
+// Ring buffer for the received data
+typedef struct {
+	uint8_t		buffer[ESP8266_RX_BUFF_SIZE];
+	uint8_t		head;						// Reading position
+	uint8_t		count;						// Number of stored bytes
+	uint16_t	pending;					// Announced by +IPD and not read yet, held by ESP8266 in the passive mode
+	WIFI_FRAME	frame[ESP8266_RX_FRAMES];	// Frames in arrival order
+	uint8_t		frames;						// Number of the frames
+	bool		datagram;					// The connection carries the datagram
+} WIFI_RXBUF;
+// Parsing phase of +IPD header
+typedef enum {
+	WIFI_IPD_NONE,							// Out of the frame
+	WIFI_IPD_FIRST,							// Connection ID or length
+	WIFI_IPD_LENGTH,						// Length following the connection ID
+	WIFI_IPD_ADDR,							// Remote address
+	WIFI_IPD_PORT,							// Remote port
+	WIFI_IPD_DATA							// Receiving the data
+} WIFI_IPD;
+
+// Datagram
+// The remote address accepted by bind, any peer can send to it.
+#define ESP8266_UDP_ANY			"0.0.0.0"
+// Datagram to be sent by sendTo in a batch
+typedef struct {
+	const char		*host;					// Destination address
+	uint16_t		port;					// Destination port
+	const uint8_t	*data;					// Data of the datagram
+	uint16_t		length;					// Length of the data
+} WIFI_DATAGRAM;
+
+// Baud rate negotiation
+// Number of the echo tests to verify the raised baud rate.
+// The rate is adopted only if all tests pass.
+#define ESP8266_BAUD_PROBES		8
+// Time-out of each echo test with millisecond unit
+#define ESP8266_BAUD_TIMEOUT	100
+// Statistics of the baud rate negotiation
+typedef struct {
+	uint32_t	baudrate;					// Selected baud rate
+	uint16_t	probes;						// Number of the echo tests
+	uint16_t	errors;						// Number of the failed echo tests
+	uint8_t		rejects;					// Number of the rates given up
+} WIFI_LINKSTAT;
+
+// Receiving serial buffer
+// Capacity of the receiving buffer of the serial to pause ESP8266 before
+// it is filled up, 0 if unknown. The overrun is detected by the serial
+// which has overflow() like SoftwareSerial, and by the +IPD payload which
+// ran over the lost bytes. The declared length of such a payload takes
+// in "\r\n+IPD," or "\r\nOK\r\n" of the next output, or the binary
+// data follows it.
+#if defined(ESP8266_USE_SOFTWARESERIAL) && defined(_SS_MAX_RX_BUFF)
+#define ESP8266_SERIAL_RX_SIZE	_SS_MAX_RX_BUFF
+#elif defined(SERIAL_RX_BUFFER_SIZE)
+#define ESP8266_SERIAL_RX_SIZE	SERIAL_RX_BUFFER_SIZE
+#else
+#define ESP8266_SERIAL_RX_SIZE	0
+#endif
+// With the RTS pin, the module is paused when the receiving serial buffer
+// exceeds 3/4 of the capacity, or when a connection buffer exceeds the
+// following. It is resumed after all connection buffers are drained
+// below ESP8266_RX_RESUME. While the sketch is blocked for the reply of
+// a command, it is not paused by the connection buffers.
+#define ESP8266_RX_PAUSE		(ESP8266_RX_BUFF_SIZE * 3 / 4)
+#define ESP8266_RX_RESUME		(ESP8266_RX_BUFF_SIZE / 4)
+// Statistics of the receiving serial
+typedef struct {
+	uint16_t	overruns;					// Number of the overruns detected
+	uint16_t	framing;					// Number of the malformed +IPD headers
+	uint16_t	invalidated;				// Frames discarded by the overrun
+	uint16_t	pauses;						// Number of the pauses by RTS
+} WIFI_UARTSTAT;
+
+#ifdef ESP8266_USE_METRICS
+// Metrics
+// Number of the latency histogram buckets. The bucket n counts the
+// latency from 2^(n-1) to 2^n - 1 milliseconds, the bucket 0 counts
+// 0 ms and the last one counts the rest.
+#define ESP8266_METRICS_BUCKETS	12
+// Metrics of each AT command
+typedef struct {
+	uint16_t	count;						// Number of the concluded commands
+	uint16_t	latency[ESP8266_METRICS_BUCKETS];	// Latency histogram
+} WIFI_CMDSTAT;
+// Metrics of the commands and the transmission
+typedef struct {
+	WIFI_CMDSTAT	command[WIFI_CMD_END];	// Metrics for each WIFI_CMD
+	uint32_t	sent;						// Sent bytes of the data
+	uint32_t	received;					// Received bytes of the data
+	uint32_t	dropped;					// Received bytes discarded by the full buffer
+	uint16_t	discarded;					// Datagrams discarded by the full frames
+	uint16_t	truncated;					// Datagrams truncated by the full buffer
+	uint32_t	flushed;					// Bytes discarded at the baud rate change
+	uint16_t	frames;						// Number of +IPD frames
+	uint16_t	timeouts;					// Number of the timed out commands
+	uint16_t	busy;						// Number of busy answers
+	uint16_t	sendFails;					// Number of the failed sending
+} WIFI_STATS;
+#endif
+
+#ifdef ESP8266_USE_POOL
+// Keep-alive connection pool
+// The connection IDs of the multiple connection are pooled by
+// the destination, and the established connection is reused.
+// Buffer size of the host name to be pooled including the terminator.
+// The longer host is connected but not reused.
+#define ESP8266_POOL_HOST_SIZE	32
+// State of the pooled connection
+typedef enum {
+	WIFI_POOL_FREE,							// Not connected
+	WIFI_POOL_IDLE,							// Connected and waiting for reuse
+	WIFI_POOL_BUSY							// Acquired or not pooled
+} WIFI_POOL;
+// Pooled connection for each connection ID
+typedef struct {
+	char		host[ESP8266_POOL_HOST_SIZE];	// Destination host
+	uint16_t	port;						// Destination port
+	WIFI_PRO	protocol;					// Connection protocol
+	WIFI_POOL	state;						// State of the connection
+	uint32_t	usedAt;						// Last acquired time
+} WIFI_POOLSLOT;
+#endif
+
+// Server event loop
+// The connections from the clients are notified by the callbacks from
+// serve, which services each connection ID in round-robin.
+// Pending events of the client
+#define WIFI_EVENT_CONNECT		0x01		// Connected from the client
+#define WIFI_EVENT_CLOSE		0x02		// Closed
+// Notification of the client connection and the closing
+typedef void (*WIFI_EVENT)(int8_t channel);
+// Notification of the received data with the available length
+typedef void (*WIFI_DATA)(int8_t channel, uint16_t length);
+// State of the client for each connection ID
+typedef struct {
+	bool		connected;					// Connected from the client
+	bool		accepted;					// Served until the closing is notified
+	uint8_t		events;						// Pending WIFI_EVENT_ bits
+	uint32_t	connectedAt;				// Time of the connection
+	void		*context;					// Sketch-specific state of the client
+} WIFI_CLIENT;
+
+// Hostname resolution cache
+// The host resolved by AT+CIPDOMAIN is connected with the cached
+// address without the lookup by ESP8266.
+// Number of the cached hosts
+#define ESP8266_DNS_ENTRIES		4
+// Buffer size of the host name to be cached including the terminator.
+// The longer host is not cached.
+#define ESP8266_DNS_HOST_SIZE	32
+// Time to live of the cached address with millisecond unit
+#define ESP8266_DNS_TTL			300000UL
+// Cached address
+typedef struct {
+	char		host[ESP8266_DNS_HOST_SIZE];	// Host name, empty if unused
+	char		ip[16];						// Resolved address
+	uint32_t	resolvedAt;					// Time of the resolution
+	uint32_t	usedAt;						// Last referred time
+} WIFI_DNSENTRY;
+// Statistics of the cache
+typedef struct {
+	uint16_t	hits;						// Number of the connection by the cached address
+	uint16_t	misses;						// Number of the host not cached
+	uint16_t	invalidated;				// Number of the entries dropped by the connect failure
+} WIFI_DNSSTAT;
+
+// Rejoining to the access point
+// The station is kept joined by autojoin and maintain. The BSSID of the
+// joined access point is cached and the next join designates it to skip
+// the full scan, the full join follows if it failed. The failed join is
+// retried with the exponential backoff and the random jitter.
+// Time until the first retry with millisecond unit, it doubles each failure.
+#define ESP8266_JOIN_BACKOFF	500
+// Upper limit of the retry interval
+#define ESP8266_JOIN_BACKOFF_MAX	60000UL
+// Buffer size of BSSID including the terminator
+#define ESP8266_BSSID_SIZE		18
+// State of the station maintained by autojoin
+typedef enum {
+	WIFI_JOIN_OFF,							// Not maintained
+	WIFI_JOIN_DOWN,							// Waiting for the next attempt
+	WIFI_JOIN_JOINING,						// Joining in progress
+	WIFI_JOIN_LEARNING,						// Joined, learning BSSID by AT+CWJAP?
+	WIFI_JOIN_UP							// Joined and got IP
+} WIFI_JOINST;
+// Statistics of the rejoining
+typedef struct {
+	uint16_t	attempts;					// Number of the join attempts
+	uint16_t	fastJoins;					// Joined by the cached BSSID
+	uint16_t	fallbacks;					// Cached BSSID failed and the full join followed
+	uint16_t	drops;						// Number of WIFI DISCONNECT while joined
+	uint16_t	recoveries;					// Number of the recoveries until GOT IP
+	uint32_t	timeToIp;					// Time of the last recovery until GOT IP
+	uint32_t	maxTimeToIp;				// Worst time until GOT IP
+	uint32_t	totalTimeToIp;				// Sum of the time until GOT IP
+} WIFI_JOINSTAT;
+
+// Access point scan
+// The +CWLAP lines are parsed one by one as they arrive, and only the
+// strongest entries up to the capacity of the list are kept in the heap
+// ordered by RSSI. AT+CWLAPOPT trims the line to the fields below, the
+// line of the firmware without it is also parsed.
+// Mask of AT+CWLAPOPT for <ecn>, <ssid>, <rssi> and <channel>
+#define ESP8266_CWLAP_MASK		0x17
+// Time-out of the scan with millisecond unit
+#define ESP8266_SCAN_TIMEOUT	10000
+// Encryption of the access point
+typedef enum {
+	WIFI_ECN_OPEN,							// Open
+	WIFI_ECN_WEP,							// WEP
+	WIFI_ECN_WPA_PSK,						// WPA_PSK
+	WIFI_ECN_WPA2_PSK,						// WPA2_PSK
+	WIFI_ECN_WPA_WPA2_PSK					// WPA_WPA2_PSK
+} WIFI_ECN;
+// Access point found by the scan
+typedef struct {
+	char		ssid[ESP8266_SSID_SIZE];	// SSID
+	int8_t		rssi;						// Signal strength with dBm
+	uint8_t		ecn;						// WIFI_ECN
+	uint8_t		channel;					// Channel, 0 if unknown
+} WIFI_AP;
+// Conditions of the access point to be kept, zero for any
+typedef struct {
+	const char	*ssid;						// SSID, it is also given to AT+CWLAP
+	uint8_t		ecnMask;					// Bits of (1 << WIFI_ECN) to be kept
+	uint8_t		channel;					// Channel
+	int8_t		minRssi;					// Weakest RSSI to be kept
+} WIFI_SCANFILTER;
+// Scan in progress
+typedef struct {
+	WIFI_AP		*list;						// Heap of the kept entries
+	uint8_t		capacity;					// Capacity of the list
+	uint8_t		count;						// Number of the kept entries
+	uint16_t	seen;						// Number of the reported entries
+	const WIFI_SCANFILTER	*filter;		// Conditions, NULL for any
+} WIFI_SCAN;
+
+// Transparent transmission
+// Guard time with millisecond unit around the escape sequence "+++".
+// The module recognizes +++ only when it is isolated from the data,
+// and it needs an interval before accepting the next AT command.
+#define ESP8266_ESCAPE_GUARD	1000
+
 // It presents the AT version of ESP8266 firmware
 #define ESP8266_AT_VERSION	022
 
+// Debug tap
+// The traffic and the command results are copied into the ring buffer
+// without blocking, and the ring is drained to the debug port at the
+// idle point where nothing has been received, because the write of
+// SoftwareSerial blocks with the interrupts disabled. The record which
+// does not fit in the ring is dropped entirely and counted.
+// Each record is stored after the header of its direction, level and
+// length, and the records of the same header are joined until drained.
+// The drained output is prefixed by "[<direction><level>]" when the
+// header changes, the direction is R, T or E of WIFI_TAP.
+// Size of the ring buffer
+#define ESP8266_TAP_SIZE		128
+// Bytes to be drained at an idle point, a byte takes 1ms at 9600bps.
+#define ESP8266_TAP_DRAIN		4
+// Direction of the tapped data, also used as the filter mask
+typedef enum {
+	WIFI_TAP_RX = 0x01,						// Received from ESP8266
+	WIFI_TAP_TX = 0x02,						// Transmitted to ESP8266
+	WIFI_TAP_EVENT = 0x04,					// Result of the command
+	WIFI_TAP_ALL = 0x07						// All directions
+} WIFI_TAP;
+// Level of the tapped record, the lower is the more important.
+typedef enum {
+	WIFI_TAPLV_OFF,							// Nothing is tapped
+	WIFI_TAPLV_ERROR,						// Failed commands
+	WIFI_TAPLV_INFO,						// All command results
+	WIFI_TAPLV_TRACE						// Raw traffic
+} WIFI_TAPLV;
+// Statistics of the debug tap
+typedef struct {
+	uint32_t	tapped;						// Bytes stored in the ring
+	uint32_t	dropped;					// Bytes dropped by the ring overflow
+	uint32_t	drained;					// Bytes written out to the debug port
+	uint16_t	peak;						// Maximum occupancy of the ring
+} WIFI_TAPSTAT;
+
+// ESP8266Tap class declaration
+// The ring is shared by all driver instances.
+class ESP8266Tap {
+
+private:
+	// Private members
+	static uint8_t		_ring[ESP8266_TAP_SIZE];	// Ring buffer
+	static uint16_t		_head;				// Position of the oldest byte
+	static uint16_t		_count;				// Occupied bytes
+	static WIFI_TAPLV	_level;				// Most verbose level to be tapped
+	static uint8_t		_filter;			// Mask of WIFI_TAP to be tapped
+	static uint16_t		_last;				// Position of the last record header
+	static uint16_t		_left;				// Bytes left in the record being drained
+	static uint8_t		_shown;				// Header last written out
+	static WIFI_TAPSTAT	_stat;				// Statistics
+
+public:
+	// Store the record to the ring if it passes the level and the filter.
+	static void			put(WIFI_TAP dir, WIFI_TAPLV level, const uint8_t *data, uint16_t length);
+	// Write out the ring up to the specified bytes.
+	static void			drain(Print &out, uint16_t limit);
+	// Set the level to be tapped.
+	static void			level(WIFI_TAPLV level);
+	// Set the directions to be tapped by WIFI_TAP mask.
+	static void			filter(uint8_t mask);
+	// Get the statistics of the debug tap.
+	static WIFI_TAPSTAT	stat(void);
+	// Discard the ring and clear the statistics.
+	static void			clear(void);
+};
+
+// Overrun flag of the serial which has overflow() like SoftwareSerial,
+// the other serial has no flag.
+template<class S>
+inline auto _serialOverflow(S &serial, int) -> decltype(serial.overflow()) { return serial.overflow(); }
+template<class S>
+inline bool _serialOverflow(S &, long) { return false; }
+
+// Policy of the driver
+// The driver is the class template over the serial type and the policy.
+// The default policy is composed of the macros above, a sketch which
+// drives the modules with the different wiring declares its own policy
+// structure having the same members. The member definitions are in
+// ESP8266.tpp which follows this header, so that the sketch instantiates
+// the driver for its own serial type or policy implicitly.
+struct ESP8266Policy {
+#ifdef ESP8266_RST_PIN
+	static const int8_t		resetPin = ESP8266_RST_PIN;		// Arduino pin for RST of ESP8266
+#else
+	static const int8_t		resetPin = -1;					// RST of ESP8266 is not wired
+#endif
+#ifdef ESP8266_RTS_PIN
+	static const int8_t		rtsPin = ESP8266_RTS_PIN;		// Arduino pin to CTS of ESP8266
+#else
+	static const int8_t		rtsPin = -1;					// CTS of ESP8266 is not wired
+#endif
+#ifdef ESP8266_CTS_PIN
+	static const int8_t		ctsPin = ESP8266_CTS_PIN;		// Arduino pin from RTS of ESP8266
+#else
+	static const int8_t		ctsPin = -1;					// RTS of ESP8266 is not wired
+#endif
+	static const uint16_t	rxSize = ESP8266_SERIAL_RX_SIZE;	// Receiving buffer of the serial
+	static const uint32_t	baudrate = ESP8266_DEF_BAUDRATE;	// Baud rate at the boot of ESP8266
+	static const uint32_t	timeOut = ESP8266_DEF_TIMEOUT;	// Time-out limit for the reply
+	// Debug tap of the traffic, and the idle point to drain it
+#ifdef ESP8266_USE_DEBUGSERIAL
+	static void	tap(WIFI_TAP dir, WIFI_TAPLV level, const uint8_t *data, uint16_t length) { ESP8266Tap::put(dir, level, data, length); }
+	static void	idle(void) { ESP8266Tap::drain(DebugSerial, ESP8266_TAP_DRAIN); }
+#else
+	static void	tap(WIFI_TAP, WIFI_TAPLV, const uint8_t *, uint16_t) {}
+	static void	idle(void) {}
+#endif
+	// Overrun flag of the serial, it is cleared by reading.
+	template<class S>
+	static bool	overrun(S &serial) { return _serialOverflow(serial, 0); }
+};
+
 // ESP8266 class declaration
-class ESP8266 {
+template<class SerialT, class Policy = ESP8266Policy>
+class ESP8266Driver {
 
 private:
 	// Private members
-	_ESP8266_SERIAL_TYPE	*_uart;			// A class instance for serial access
+	SerialT		*_uart;						// A class instance for serial access
 	uint32_t	_baudrate;					// ESP8266 access baudrate
 	WIFI_CONN	_conn;						// Connection topology
 	WIFI_PRO	_protocol;					// Applied protocol for the current connection
 	char		_ipAddrSta[16];				// Station IP address for this ESP8266
 	char		_ipAddrAp[16];				// Access point IP address for this ESP8266
+	WIFI_CMDSLOT	_cmd[ESP8266_CMD_SLOTS];	// Asynchronous commands queue
+	uint8_t		_cmdHead;					// Oldest command in progress
+	uint8_t		_cmdCount;					// Number of the commands in progress
+	uint8_t		_cmdDepth;					// Pipeline depth
+	WIFI_HANDLE	_handle;					// Handle generator
+	uint8_t		_findState;					// Matching state of the response terms
+	WIFI_RXBUF	_rx[ESP8266_RX_CHANNELS];	// Received data for each connection ID
+	uint8_t		_rxChannel;					// Connection ID to be read by read()
+	WIFI_IPD	_ipdPhase;					// +IPD header parsing phase
+	uint8_t		_ipdChannel;				// Connection ID of the current frame
+	uint16_t	_ipdRemain;					// Remaining length of the current frame
+	uint16_t	_ipdLength;					// Length announced by +IPD
+	uint16_t	_ipdValue;					// Number being parsed in +IPD header
+	uint8_t		_ipdOctet;					// Octet being parsed of the remote address
+	WIFI_FRAME	_ipdFrame;					// Frame being parsed
+	uint8_t		_ipdMark;					// Matched length of "\r\n+IPD," in the payload
+	uint8_t		_okMark;					// Matched length of "\r\nOK\r\n" in the payload
+	bool		_dinfo;						// AT+CIPDINFO=1 has been applied
+	bool		_passive;					// AT+CIPRECVMODE=1 has been applied
+	bool		_lapopt;					// AT+CWLAPOPT has been tried
+	bool		_passiveId;					// The announcement has the connection ID
+	uint8_t		*_pullBuf;					// Destination of AT+CIPRECVDATA
+	uint16_t	_pullSize;					// Requested length of AT+CIPRECVDATA
+	uint16_t	_pulled;					// Length stored by AT+CIPRECVDATA
+	bool		_transparent;				// Transparent transmission in progress
+	uint32_t	_txAt;						// Last writing time in the transparent transmission
+	WIFI_LINKSTAT	_link;					// Statistics of the baud rate negotiation
+	WIFI_UARTSTAT	_uartStat;				// Statistics of the receiving serial
+	bool		_paused;					// ESP8266 is paused by RTS
+	bool		_waiting;					// The sketch is blocked for the reply
+	char		_line[ESP8266_LINE_SIZE];	// Response line being framed
+	uint8_t		_lineLen;					// Length of the framing line
+	bool		_lineTaken;					// The line has been taken by the command
+	WIFI_NOTICE	_onNotice;					// Unsolicited line handler
+#ifdef ESP8266_USE_POOL
+	WIFI_POOLSLOT	_pool[ESP8266_RX_CHANNELS];	// Pooled connections
+#endif
+#ifdef ESP8266_USE_DNSCACHE
+	WIFI_DNSENTRY	_dns[ESP8266_DNS_ENTRIES];	// Resolved addresses
+#endif
+	WIFI_CLIENT	_client[ESP8266_RX_CHANNELS];	// Clients of the server
+	uint8_t		_serveNext;					// Connection ID to be serviced first
+	WIFI_EVENT	_onConnect;					// Client connection handler
+	WIFI_DATA	_onData;					// Received data handler
+	WIFI_EVENT	_onClose;					// Closing handler
+#ifdef ESP8266_USE_DNSCACHE
+	WIFI_DNSSTAT	_dnsStat;				// Statistics of the resolution cache
+#endif
+	WIFI_STREAM	_stream;					// Source of the large transmission
+	WIFI_STREAMSTAT	_streamStat;			// Result of the large transmission
+	const char	*_joinSsid;					// SSID maintained by autojoin
+	const char	*_joinPwd;					// Pass phrase maintained by autojoin
+	char		_bssid[ESP8266_BSSID_SIZE];	// BSSID of the last joined access point
+	uint8_t		_bssidChannel;				// Channel of the last joined access point
+	WIFI_JOINST	_joinState;					// State of the station
+	WIFI_HANDLE	_joinHandle;				// Join or BSSID inquiry in progress
+	bool		_joinFast;					// The join designates the cached BSSID
+	uint8_t		_joinRetries;				// Number of the consecutive failures
+	uint32_t	_joinAt;					// Time of the next attempt
+	uint32_t	_downAt;					// Time of the recovery started
+	bool		_downTiming;				// Measuring the time until GOT IP
+	WIFI_JOINSTAT	_joinStat;				// Statistics of the rejoining
+#ifdef ESP8266_USE_METRICS
+	WIFI_STATS	_stats;						// Metrics
+#endif
 
 	// Private methods
 	WIFI_ERR	_connect(int8_t channel, WIFI_PRO protocol, char *address, uint16_t port);
+	WIFI_HANDLE	_connectAsync(int8_t channel, WIFI_PRO protocol, char *address, uint16_t port, WIFI_CALLBACK callback, uint16_t localPort = 0);
+	WIFI_HANDLE	_configAsync(WIFI_CMD cmd, uint8_t value);
 	WIFI_ERR	_send(int8_t channel, const uint8_t *data);
-	void		setBaudrate(uint32_t baudrate);
-	void		readFlush(void);
-	WIFI_ERR	response(uint32_t timeout = ESP8266_DEF_TIMEOUT);
-	bool		scan(const char *token);
-	int8_t		readUntil(uint8_t *result, uint8_t terminator);
+	WIFI_HANDLE	_joinAsync(const char *ssid, const char *pwd, const char *bssid, WIFI_CALLBACK callback);
+	WIFI_HANDLE	_learnAsync(void);
+	void		_joined(void);
+	WIFI_ERR	setBaudrate(uint32_t baudrate);
+	void		_switch(uint32_t baudrate);
+	uint8_t		_probe(uint32_t baudrate, uint8_t count);
+	bool		_shift(uint32_t baudrate);
+	bool		_progress(void);
+	bool		_ready(bool exclusive = false);
+	bool		_vacant(bool exclusive = false);
+	bool		_hopeful(WIFI_HANDLE handle);
+	WIFI_CMDSLOT	*_tail(void);
+	WIFI_HANDLE	_submit(WIFI_CMD cmd, uint32_t timeOut, WIFI_CALLBACK callback, const WIFI_SEGMENT *segment = NULL, uint8_t segments = 0);
+	void		_write(const WIFI_SEGMENT *segment, uint8_t segments);
+	void		_produce(uint16_t length);
+	WIFI_ERR	_sendStream(int8_t channel, uint32_t length, WIFI_PROGRESS progress);
+	bool		_advance(WIFI_ERR condition);
+	void		_conclude(WIFI_ERR err);
+	void		_finish(WIFI_CMDSLOT *slot, WIFI_ERR err);
+	void		_tapResult(WIFI_CMD cmd, WIFI_ERR err);
+	void		_flow(bool pause);
+	bool		_congested(uint8_t level);
+	void		_invalidate(void);
+	void		_announce(uint8_t channel, bool id);
+	int16_t		_pull(int8_t channel, uint8_t *buffer, uint16_t size);
+	void		_idle(void);
+	void		_pump(void);
+	void		_dispatch(const uint8_t *data, uint8_t length);
+	void		_dispatch(uint8_t c);
+	uint8_t		_store(WIFI_RXBUF *rx, const uint8_t *data, uint8_t length);
+	uint8_t		_overran(const uint8_t *data, uint8_t length);
+	void		_ipdBegin(void);
+	void		_ipdEnd(void);
+	uint16_t	_take(WIFI_RXBUF *rx, uint8_t *buffer, uint16_t size);
+	void		_consume(WIFI_RXBUF *rx, uint16_t length);
+	WIFI_HANDLE	_sendAsync(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments, const char *host, uint16_t port, WIFI_CALLBACK callback);
+	void		_frame(uint8_t c);
+	bool		_collect(WIFI_CMDSLOT *slot, const char *line);
+	void		_notice(const char *line);
+	int8_t		_pending(int8_t channel);
+#ifdef ESP8266_USE_DNSCACHE
+	WIFI_DNSENTRY	*_dnsFind(const char *host);
+	WIFI_DNSENTRY	*_dnsLookup(const char *host);
+	WIFI_DNSENTRY	*_resolve(const char *host);
+#else
+	// Without the cache, ESP8266 resolves the host at each connection.
+	WIFI_DNSENTRY	*_dnsFind(const char *) { return NULL; }
+	WIFI_DNSENTRY	*_dnsLookup(const char *) { return NULL; }
+	WIFI_DNSENTRY	*_resolve(const char *) { return NULL; }
+#endif
+#ifdef ESP8266_USE_METRICS
+	void		_measure(const WIFI_CMDSLOT *slot);
+#endif
 
 public:
 	// Constructor
-	ESP8266(_ESP8266_SERIAL_TYPE &uart);
+	ESP8266Driver(SerialT &uart);
 	// Hardware reset for HSP8266 module.
 	bool		reset(WIFI_RESET rst);
 	// Begin WIFI connection and transmission.
-	bool		begin(uint32_t baudrate = ESP8266_DEF_BAUDRATE);
+	bool		begin(uint32_t baudrate = Policy::baudrate);
+	// Find the baud rate of ESP8266 and raise it as fast as possible.
+	uint32_t	autobaud(uint32_t maxBaudrate = ESP8266_BAUD_MAX);
+	// Get the selected baud rate and the statistics of the negotiation.
+	WIFI_LINKSTAT	linkStat(void);
+	// Get the overrun and the flow control statistics of the receiving serial.
+	WIFI_UARTSTAT	uartStat(void);
 	// End WIFI connection.
 	void		end(void);
 	// Configure connection mode and multi connection.
@@ -175,6 +861,16 @@ public:
 	WIFI_ERR	join(const char *ssid, const char *pwd);
 	// Disconnect from the WiFi access point.
     WIFI_ERR	disconnect(void);
+	// Keep the station joined to the access point, NULL to stop.
+	void		autojoin(const char *ssid, const char *pwd);
+	// Advance the rejoining, call it from the loop.
+	WIFI_JOINST	maintain(void);
+	// Get BSSID of the last joined access point, empty if unknown.
+	const char	*bssid(void);
+	// Get the statistics of the rejoining.
+	WIFI_JOINSTAT	joinStat(void);
+	// Scan the access points and keep the strongest ones.
+	int8_t		scan(WIFI_AP *list, uint8_t capacity, const WIFI_SCANFILTER *filter = NULL);
 	// Inquire the connection establishment status with specified the access point.
 	bool		isConnect(char *ssid);
 	// Get IP address and report resulted IP address string.
@@ -189,29 +885,128 @@ public:
 	WIFI_ERR	connect(int8_t channel, char *address, uint16_t port);
 	// Start IP connection for server side with passive SYN.
 	WIFI_ERR	server(uint16_t port);
+	// Set the time-out to close the idle client with second unit.
+	WIFI_ERR	serverTimeout(uint16_t timeOut);
+	// Set the handlers of the server events.
+	void		onConnect(WIFI_EVENT handler);
+	void		onData(WIFI_DATA handler);
+	void		onClose(WIFI_EVENT handler);
+	// Service the clients, call it from the loop.
+	void		serve(void);
+	// Get the state of the client.
+	WIFI_CLIENT	*client(int8_t channel);
 	// Sending data along with making a connection establishment.
 	WIFI_ERR	send(int8_t channel, char *address, uint16_t port, const uint8_t *data);
 	// Send data with connection ID specified.
 	WIFI_ERR	send(int8_t channel, const uint8_t *data);
 	// Send data with no connection ID specified.
 	WIFI_ERR	send(const uint8_t *data);
+	// Send the binary data of the specified length.
+	WIFI_ERR	send(int8_t channel, const uint8_t *data, uint16_t length);
+	// Send the data gathered from the segments by one transmission.
+	WIFI_ERR	send(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments);
+	// Send the long data by splitting into the segments of ESP8266_SEND_MAX.
+	WIFI_ERR	sendStream(int8_t channel, uint32_t length, WIFI_PRODUCER producer, WIFI_PROGRESS progress = NULL);
+	WIFI_ERR	sendStream(int8_t channel, uint32_t length, Stream &source, WIFI_PROGRESS progress = NULL);
+	WIFI_ERR	sendStream(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments, WIFI_PROGRESS progress = NULL);
+	// Get the result and the throughput of the last large transmission.
+	WIFI_STREAMSTAT	streamStat(void);
+	// Bind the local port to the connection for the datagram.
+	WIFI_ERR	bind(int8_t channel, uint16_t localPort, const char *host = ESP8266_UDP_ANY, uint16_t port = 0);
+	// Send the datagram to the destination through the bound connection.
+	WIFI_ERR	sendTo(int8_t channel, const char *host, uint16_t port, const uint8_t *data, uint16_t length);
+	// Send the datagrams back to back, returns the number of the sent.
+	uint8_t		sendTo(int8_t channel, const WIFI_DATAGRAM *datagram, uint8_t count);
+	// Receive a datagram with its remote end, 0 if not arrived.
+	int16_t		recvFrom(int8_t channel, uint8_t *buffer, uint16_t size, char *host = NULL, uint16_t *port = NULL);
+	// Switch the passive receive mode, receive pulls the data held by ESP8266.
+	WIFI_ERR	passive(bool enable);
 	// Start listening, and then stores the received data to the buffer.
-	int16_t		receive(uint8_t *buffer, uint16_t size, uint32_t timeOut = ESP8266_DEF_TIMEOUT);
+	int16_t		receive(uint8_t *buffer, uint16_t size, uint32_t timeOut = Policy::timeOut);
 	// Start listening at the specified connection, and then stores the received data to the buffer.
-	int16_t		receive(int8_t channel, uint8_t *buffer, uint16_t size, uint32_t timeOut = ESP8266_DEF_TIMEOUT);
+	int16_t		receive(int8_t channel, uint8_t *buffer, uint16_t size, uint32_t timeOut = Policy::timeOut);
 	// Starts the listening, and returns data length necessary for receiving.
 	int16_t		listen(uint32_t timeOut = 0);
 	// Starts the listening from selected connection, and returns data length necessary for receiving.
 	int16_t		listen(int8_t channel, uint32_t timeOut = 0);
 	// Get the number of bytes available for reading from ESP8266. 
 	int16_t		available(void);
+	// Get the number of bytes available for reading from the specified connection.
+	int16_t		available(int8_t channel);
 	// Return a character that was received from ESP8266.
 	int16_t		read(void);
+	// Read the received data of the specified connection to the buffer.
+	int16_t		read(int8_t channel, uint8_t *buffer, uint16_t size);
 	// Close the currently active IP connection.
 	void		close(void);
 	// Close IP connection with specified connection ID.
 	void		close(int8_t channel);
+	// Enter the transparent transmission with the current single connection.
+	WIFI_ERR	beginTransparent(void);
+	// Escape from the transparent transmission.
+	WIFI_ERR	endTransparent(void);
+	// Write the data during the transparent transmission.
+	uint16_t	write(const uint8_t *data, uint16_t length);
+	uint16_t	write(uint8_t c);
+
+	// Asynchronous methods
+	// Each method issues the command and returns its handle without
+	// waiting for the reply. The command progresses by the poll method.
+	// Connect to the WiFi access point asynchronously.
+	WIFI_HANDLE	joinAsync(const char *ssid, const char *pwd, WIFI_CALLBACK callback = NULL);
+	// Disconnect from the WiFi access point asynchronously.
+	WIFI_HANDLE	disconnectAsync(WIFI_CALLBACK callback = NULL);
+	// Start IP connection asynchronously, -1 to the channel for single connection.
+	WIFI_HANDLE	connectAsync(int8_t channel, char *address, uint16_t port, WIFI_CALLBACK callback = NULL);
+	// Start IP connection for server side asynchronously.
+	WIFI_HANDLE	serverAsync(uint16_t port, WIFI_CALLBACK callback = NULL);
+	// Send data asynchronously, -1 to the channel for single connection.
+	WIFI_HANDLE	sendAsync(int8_t channel, const uint8_t *data, WIFI_CALLBACK callback = NULL);
+	WIFI_HANDLE	sendAsync(int8_t channel, const uint8_t *data, uint16_t length, WIFI_CALLBACK callback = NULL);
+	WIFI_HANDLE	sendAsync(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments, WIFI_CALLBACK callback = NULL);
+	// Send the datagram asynchronously.
+	WIFI_HANDLE	sendToAsync(int8_t channel, const char *host, uint16_t port, const uint8_t *data, uint16_t length, WIFI_CALLBACK callback = NULL);
+	// Close IP connection asynchronously, -1 to the channel for the current.
+	WIFI_HANDLE	closeAsync(int8_t channel = -1, WIFI_CALLBACK callback = NULL);
+	// Advance the command in progress, returns true while in progress.
+	bool		poll(void);
+	// Get the result of the command, WIFI_ERR_PENDING while in progress.
+	WIFI_ERR	result(WIFI_HANDLE handle);
+	// Wait for the command conclusion.
+	WIFI_ERR	wait(WIFI_HANDLE handle);
+#ifdef ESP8266_USE_POOL
+	// Get the connection to the destination from the pool.
+	int8_t		acquire(const char *host, uint16_t port, WIFI_PRO protocol = WIFI_PRO_TCP);
+	// Return the connection to the pool and keep it alive.
+	void		release(int8_t channel);
+#endif
+#ifdef ESP8266_USE_DNSCACHE
+	// Resolve the host name and cache the address.
+	char		*resolve(const char *host);
+	// Drop the cached address of the host, NULL for all hosts.
+	void		invalidate(const char *host = NULL);
+	// Get the statistics of the resolution cache.
+	WIFI_DNSSTAT	dnsStat(void);
+#endif
+	// Set the handler of the unsolicited line.
+	void		onNotice(WIFI_NOTICE handler);
+	// Set the number of the commands to be issued back to back.
+	void		pipeline(uint8_t depth);
+#ifdef ESP8266_USE_METRICS
+	// Take a snapshot of the metrics.
+	void		stats(WIFI_STATS *snapshot);
+	// Clear the metrics.
+	void		resetStats(void);
+#endif
 };
 
+// Member definitions of the driver
+#include "ESP8266.tpp"
+
+// The default driver is instantiated in ESP8266.cpp only once.
+extern template class ESP8266Driver<_ESP8266_SERIAL_TYPE, ESP8266Policy>;
+// ESP8266 class for the default serial type with the default policy
+typedef ESP8266Driver<_ESP8266_SERIAL_TYPE>	ESP8266;
+
 extern	ESP8266	WiFi;
 #endif	/* __ESP8266_H__ */
@@ -0,0 +1,3703 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	ESP8266Driver class template implementation that contains whole
+	members and methods. It is included at the end of ESP8266.h so that
+	the driver can be instantiated by the sketch for its own serial type
+	and policy, the default one is instantiated once in ESP8266.cpp.
+*/
+
+#ifdef ESP8266_USE_DEBUGSERIAL
+// Enable echo back of the command when it uses the DEBUGSERIAL.
+#define ESP8266_AT_ATE		"ATE1"
+
+#else
+// DEBUGSERIAL is not available here.
+// Unable the command echo back
+#define ESP8266_AT_ATE		"ATE0"
+#endif
+
+// Metrics counting is compiled only with ESP8266_USE_METRICS.
+#ifdef ESP8266_USE_METRICS
+#define ESP8266_Metric(x)		do { x; } while(0)
+#else
+#define ESP8266_Metric(x)		do {} while(0)
+#endif
+
+// Resolve version differences of AT commands.
+// Some AT commands are deprecated in older version and describe
+// in the document of '4A-AT-Espressif AT Instruction Set_v0.22.pdf'
+// for details.
+#if ESP8266_AT_VERSION < 022
+#define ESP8266_AT_UART		"AT+UART"
+#define ESP8266_AT_CWMODE	"AT+CWMODE"
+#define ESP8266_AT_CWJAP	"AT+CWJAP"
+#else
+#define ESP8266_AT_UART		"AT+UART_CUR"
+#define ESP8266_AT_CWMODE	"AT+CWMODE_CUR"
+#define ESP8266_AT_CWJAP	"AT+CWJAP_CUR"
+#endif
+
+// Helpers of the driver which are not bound to the serial type.
+// The functions are inline and the tables are defined once in
+// ESP8266.cpp, so that each driver shares them.
+namespace ESP8266Detail {
+
+// Baud rates to be negotiated in ascending order.
+const uint8_t	_BAUD_RATES = 9;
+extern const uint32_t	_BAUD_RATE[_BAUD_RATES] PROGMEM;
+
+// Pseudo connection ID of the data pulled by AT+CIPRECVDATA
+const uint8_t	_PULL_CHANNEL = 0xff;
+
+#ifdef ESP8266_USE_DEBUGSERIAL
+// DebugSerial has begun by a driver
+extern bool	_debugBegun;
+#endif
+
+/**
+ * Inquire whether the host is the IP address literal.
+ * @parameter	host	Host name or IP address
+ * @return		true	IP address literal
+ */
+inline bool _literal(const char *host) {
+	return host[strspn(host, "0123456789.")] == '\0';
+}
+
+/**
+ * Inquire whether the character belongs to the text line of ESP8266.
+ * The payload of +IPD is followed by the text, so the binary character
+ * after it reveals the payload which ran over the lost bytes.
+ * @parameter	c	Character
+ * @return		true	Printable or the newline
+ */
+inline bool _textual(uint8_t c) {
+	return c == '\r' || c == '\n' || (c >= ' ' && c <= '~');
+}
+
+// Outputs which a payload ran over the lost bytes takes in
+extern const char	_IPD_MARK[8] PROGMEM;
+extern const char	_OK_MARK[7] PROGMEM;
+
+/**
+ * Advance the matching of the output within the payload.
+ * Neither output has CR after the first one, so the mismatch restarts
+ * from CR.
+ * @parameter	state	Matched length
+ * @parameter	mark	Output in PROGMEM
+ * @parameter	c		Character of the payload
+ * @return		Matched length including the character
+ */
+inline uint8_t _markStep(uint8_t state, PGM_P mark, uint8_t c) {
+	if (c == (uint8_t)pgm_read_byte(mark + state))
+		return state + 1;
+	return c == '\r' ? 1 : 0;
+}
+
+/**
+ * Format the IP address in the dotted decimal.
+ * @parameter	dest	Destination, 16 bytes at least
+ * @parameter	ip		Octets of the address
+ */
+inline void _dotted(char *dest, const uint8_t *ip) {
+	uint8_t	i, v;
+
+	for (i = 0; i < 4; i++) {
+		if (i)
+			*dest++ = '.';
+		v = ip[i];
+		if (v >= 100)
+			*dest++ = (char)('0' + v / 100);
+		if (v >= 10)
+			*dest++ = (char)('0' + v / 10 % 10);
+		*dest++ = (char)('0' + v % 10);
+	}
+	*dest = '\0';
+}
+
+/**
+ * Sift up the entry of the heap which has the weakest RSSI at the root.
+ * @parameter	heap	Heap of the entries
+ * @parameter	i		Index of the entry
+ */
+inline void _heapUp(WIFI_AP *heap, uint8_t i) {
+	WIFI_AP		entry = heap[i];
+	uint8_t		parent;
+
+	while (i && heap[parent = (i - 1) / 2].rssi > entry.rssi) {
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = entry;
+}
+
+/**
+ * Sift down the entry of the heap which has the weakest RSSI at the root.
+ * @parameter	heap	Heap of the entries
+ * @parameter	count	Number of the entries
+ * @parameter	i		Index of the entry
+ */
+inline void _heapDown(WIFI_AP *heap, uint8_t count, uint8_t i) {
+	WIFI_AP		entry = heap[i];
+	uint16_t	child;
+
+	while ((child = 2 * (uint16_t)i + 1) < count) {
+		if (child + 1 < count && heap[child + 1].rssi < heap[child].rssi)
+			child++;
+		if (entry.rssi <= heap[child].rssi)
+			break;
+		heap[i] = heap[child];
+		i = (uint8_t)child;
+	}
+	heap[i] = entry;
+}
+
+/**
+ * Hold the writing while ESP8266 deasserts RTS wired to the CTS pin.
+ * It gives up by the time-out so as not to hang by the unwired pin.
+ */
+template<class Policy>
+inline void _clearToSend(void) {
+	uint32_t	start;
+
+	if (Policy::ctsPin < 0)
+		return;
+	start = millis();
+	while (digitalRead(Policy::ctsPin) == HIGH && millis() - start < Policy::timeOut)
+		;
+}
+
+}	// namespace ESP8266Detail
+
+/**
+ * Command line builder.
+ * The AT command line is assembled on the stack buffer from the PROGMEM
+ * literals, the numbers and the quoted strings, and it is written out
+ * by one write() at the end of the line.
+ */
+template<class SerialT, class Policy>
+class _CmdLine {
+public:
+	_CmdLine(SerialT *uart) : _uart(uart), _len(0) {}
+	// Append a character.
+	_CmdLine &put(char c) {
+		if (_len >= sizeof(_buf))
+			flush();
+		_buf[_len++] = (uint8_t)c;
+		return *this;
+	}
+	// Append the literal in PROGMEM.
+	_CmdLine &text(const __FlashStringHelper *s) {
+		PGM_P	sp = reinterpret_cast<PGM_P>(s);
+		char	c;
+
+		while ((c = (char)pgm_read_byte(sp++)) != '\0')
+			put(c);
+		return *this;
+	}
+	// Append the string enclosed in the double quotes.
+	// '"', ',' and '\' in the string are escaped by the backslash.
+	_CmdLine &quote(const char *s) {
+		put('"');
+		while (*s) {
+			if (*s == '"' || *s == ',' || *s == '\\')
+				put('\\');
+			put(*s++);
+		}
+		return put('"');
+	}
+	// Append the number in decimal.
+	_CmdLine &number(uint32_t n) {
+		char	digit[10];
+		uint8_t	i = 0;
+
+		do {
+			digit[i++] = (char)('0' + n % 10);
+			n /= 10;
+		} while (n);
+		while (i)
+			put(digit[--i]);
+		return *this;
+	}
+	// Terminate the line by CR-LF and write it out.
+	void	end(void) {
+		put('\r');
+		put('\n');
+		flush();
+	}
+	// Write out the assembled part.
+	void	flush(void) {
+		if (_len) {
+			ESP8266Detail::_clearToSend<Policy>();
+			_uart->write(_buf, _len);
+			Policy::tap(WIFI_TAP_TX, WIFI_TAPLV_TRACE, _buf, _len);
+		}
+		_len = 0;
+	}
+
+private:
+	SerialT		*_uart;						// Destination serial
+	uint8_t		_buf[ESP8266_CMDLINE_SIZE];	// Assembling line
+	uint8_t		_len;						// Length of the assembled part
+};
+
+/**
+ * ESP8266 class constructor.
+ * Choose to either use software serial or hardware serial to
+ * ESP8266 access and specify baud rate for communication between
+ * ESP8266 and an arduino.
+ * @parameter	uart		The instance of Serial object
+ * @parameter	baudrate	Baud rate
+ */
+template<class SerialT, class Policy>
+ESP8266Driver<SerialT, Policy>::ESP8266Driver(SerialT &uart) : _uart(&uart) {
+	// Start constructor
+	_baudrate = Policy::baudrate;
+	_conn = WIFI_CONN_NONE;
+	memset(_cmd, 0, sizeof(_cmd));
+	for (uint8_t i = 0; i < ESP8266_CMD_SLOTS; i++)
+		_cmd[i].handle = WIFI_HANDLE_NONE;
+	_cmdHead = 0;
+	_cmdCount = 0;
+	_cmdDepth = ESP8266_CMD_DEPTH;
+	_handle = 0;
+	_findState = 0;
+	memset(_rx, 0, sizeof(_rx));
+	_rxChannel = 0;
+	_ipdPhase = WIFI_IPD_NONE;
+	_dinfo = false;
+	_passive = false;
+	_lapopt = false;
+	_passiveId = false;
+	_pullBuf = NULL;
+	_transparent = false;
+	memset(&_link, 0, sizeof(_link));
+	_link.baudrate = _baudrate;
+	memset(&_uartStat, 0, sizeof(_uartStat));
+	_paused = false;
+	_waiting = false;
+	ESP8266_Metric(memset(&_stats, 0, sizeof(_stats)));
+	_lineLen = 0;
+	_lineTaken = false;
+	_onNotice = NULL;
+#ifdef ESP8266_USE_POOL
+	memset(_pool, 0, sizeof(_pool));
+#endif
+#ifdef ESP8266_USE_DNSCACHE
+	memset(_dns, 0, sizeof(_dns));
+#endif
+	memset(_client, 0, sizeof(_client));
+	_serveNext = 0;
+	_onConnect = NULL;
+	_onData = NULL;
+	_onClose = NULL;
+#ifdef ESP8266_USE_DNSCACHE
+	memset(&_dnsStat, 0, sizeof(_dnsStat));
+#endif
+	memset(&_stream, 0, sizeof(_stream));
+	memset(&_streamStat, 0, sizeof(_streamStat));
+	_joinSsid = NULL;
+	_joinPwd = NULL;
+	_bssid[0] = '\0';
+	_bssidChannel = 0;
+	_joinState = WIFI_JOIN_OFF;
+	_joinHandle = WIFI_HANDLE_NONE;
+	_downTiming = false;
+	memset(&_joinStat, 0, sizeof(_joinStat));
+
+	// Start ESP8266 communication port.
+	_uart->begin(_baudrate);
+	_uart->setTimeout(Policy::timeOut);
+
+	// Configure for ESP8266 reset to apply the module restart.
+	if (Policy::resetPin >= 0)
+		pinMode(Policy::resetPin, OUTPUT);
+	// The flow control pins, ESP8266 is allowed to send.
+	if (Policy::rtsPin >= 0) {
+		pinMode(Policy::rtsPin, OUTPUT);
+		digitalWrite(Policy::rtsPin, LOW);
+	}
+	if (Policy::ctsPin >= 0)
+		pinMode(Policy::ctsPin, INPUT);
+
+	// Prepare an alternative serial port for debugging.
+#ifdef ESP8266_USE_DEBUGSERIAL
+	// It is shared by the drivers, so only the first one begins it.
+	if (!ESP8266Detail::_debugBegun) {
+		DebugSerial.begin(_ESP8266_DBG_BAUDRATE);
+		ESP8266Detail::_debugBegun = true;
+	}
+#endif
+}
+
+/**
+ * Reset ESP8266 by the RST signal with hardware.
+ * @parameter	rst		WIFI_RESET enumeration value
+ * @return		true	ESP3266 module successfully started
+ *				false	some error occurred
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::reset(WIFI_RESET rst) {
+	WIFI_HANDLE	handle;
+
+	// The commands in progress would be lost by the reset.
+	while (_progress())
+		_conclude(WIFI_ERR_ERROR);
+	_transparent = false;
+	_ipdPhase = WIFI_IPD_NONE;
+	_dinfo = false;
+	_passive = false;
+	_lapopt = false;
+	_passiveId = false;
+	_pullBuf = NULL;
+	_conn = WIFI_CONN_NONE;
+	// The maintained station joins again after the restart.
+	if (_joinState != WIFI_JOIN_OFF) {
+		_joinState = WIFI_JOIN_DOWN;
+		_joinAt = millis();
+	}
+#ifdef ESP8266_USE_POOL
+	memset(_pool, 0, sizeof(_pool));
+#endif
+	memset(_client, 0, sizeof(_client));
+	// The received data of the lost connections is discarded.
+	memset(_rx, 0, sizeof(_rx));
+	_rxChannel = 0;
+
+	switch (rst) {
+	case WIFI_RESET_HARD:
+		// Go on the reset sequence by hardware
+		_uart->end();
+		_uart->begin(Policy::baudrate);
+		_uart->setTimeout(Policy::timeOut);
+		if (Policy::resetPin >= 0) {
+			digitalWrite(Policy::resetPin, LOW);
+			delay(1);
+			digitalWrite(Policy::resetPin, HIGH);
+		}
+		break;
+	case WIFI_RESET_SOFT:
+		// Go on the reset sequence by AT+RST command
+		_CmdLine<SerialT, Policy>(_uart).text(F("AT+RST")).end();
+		_uart->end();
+		_uart->begin(Policy::baudrate);
+		_uart->setTimeout(Policy::timeOut);
+		break;
+	}
+	_baudrate = Policy::baudrate;
+	_findState = 0;
+	_lineLen = 0;
+	// The boot messages are taken until "ready".
+	handle = _submit(WIFI_CMD_RST, ESP8266_RESET_TIMEOUT, NULL);
+	return wait(handle) == WIFI_ERR_OK;
+}
+
+/**
+ * Start UART session with ESP3266 communication.
+ * @parameter	baudrate	Baud rate of UART for ESP32688 communication
+ * @return		true		ESP3266 communication successfully started
+ *				false		some error occurred
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::begin(uint32_t baudrate) {
+	//
+	_idle();
+	(void)setBaudrate(baudrate);
+	_CmdLine<SerialT, Policy>(_uart).text(F(ESP8266_AT_ATE)).end();
+	if (wait(_submit(WIFI_CMD_GENERIC, Policy::timeOut, NULL)) == WIFI_ERR_OK) {
+		_baudrate = baudrate;
+		_link.baudrate = baudrate;
+		return true;
+	} else
+		return false;
+}
+
+/**
+ * Negotiate the baud rate with ESP8266.
+ * It finds the current baud rate of ESP8266 by the echo test, and
+ * then raises it step by step up to maxBaudrate. Each raised rate is
+ * verified by ESP8266_BAUD_PROBES echo tests, it goes back to the
+ * previous rate and stops raising at the first failure. The baud
+ * rate is changed by AT+UART_CUR, so it returns to the default by
+ * the module reset.
+ * @parameter	maxBaudrate	Upper limit of the baud rate
+ * @return		Selected baud rate, 0 if ESP8266 does not respond
+ */
+template<class SerialT, class Policy>
+uint32_t ESP8266Driver<SerialT, Policy>::autobaud(uint32_t maxBaudrate) {
+	uint32_t	rate;
+	uint8_t		i;
+
+	_idle();
+	if (!_ready())
+		return 0;
+	memset(&_link, 0, sizeof(_link));
+	// Find the current baud rate, try the last rate at first.
+	if (!_probe(_baudrate, 2)) {
+		for (i = 0; i < ESP8266Detail::_BAUD_RATES; i++) {
+			rate = pgm_read_dword(&ESP8266Detail::_BAUD_RATE[i]);
+			if (rate != _baudrate && _probe(rate, 2))
+				break;
+		}
+		if (i >= ESP8266Detail::_BAUD_RATES) {
+			_switch(_baudrate);
+			return 0;
+		}
+		_baudrate = rate;
+	}
+	_CmdLine<SerialT, Policy>(_uart).text(F(ESP8266_AT_ATE)).end();
+	(void)wait(_submit(WIFI_CMD_GENERIC, Policy::timeOut, NULL));
+
+	// Ramp up while the link holds up.
+	for (i = 0; i < ESP8266Detail::_BAUD_RATES; i++) {
+		rate = pgm_read_dword(&ESP8266Detail::_BAUD_RATE[i]);
+		if (rate <= _baudrate)
+			continue;
+		if (rate > maxBaudrate || !_shift(rate))
+			break;
+	}
+	_link.baudrate = _baudrate;
+	return _baudrate;
+}
+
+/**
+ * Get the statistics of the baud rate negotiation.
+ * @return		WIFI_LINKSTAT
+ */
+template<class SerialT, class Policy>
+WIFI_LINKSTAT ESP8266Driver<SerialT, Policy>::linkStat(void) {
+	return _link;
+}
+
+/**
+ * Get the statistics of the receiving serial.
+ * @return		WIFI_UARTSTAT
+ */
+template<class SerialT, class Policy>
+WIFI_UARTSTAT ESP8266Driver<SerialT, Policy>::uartStat(void) {
+	return _uartStat;
+}
+
+/**
+ * Close UART session with ESP3266 communication.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::end(void) {
+	(void)disconnect();
+	_CmdLine<SerialT, Policy>(_uart).text(F("ATE1")).end();
+	_uart->end();
+}
+
+/**
+ * Configuration WiFi mode, IP transfer mode and multiple connection mode.
+ * @parameter	mode	<code>WIFI_MODE</code> enumeration value for CWMODE
+ * @parameter	mux		<code>WIFI_MUX</code> enumeration value for CIPMUX
+ * @parameter	ipMode	<code>WIFI_IPMODE</code> enumeration value for CIPMODE
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::config(WIFI_MODE mode, WIFI_MUX mux, WIFI_IPMODE ipMode) {
+	// WIFI mode (station/softAP/station+softAP), multiple connections
+	// and transfer mode. CIPMODE command is available if the IP is
+	// connected, so it would be skipped when WIFI_IPMODE_NODESC is specified.
+	const WIFI_CMD	cmd[3] = { WIFI_CMD_CWMODE, WIFI_CMD_CIPMUX, WIFI_CMD_CIPMODE };
+	const uint8_t	value[3] = { (uint8_t)mode, (uint8_t)mux, (uint8_t)ipMode };
+	uint8_t		count = ipMode != WIFI_IPMODE_NODESC ? 3 : 2;
+	WIFI_HANDLE	handle[3];
+	WIFI_ERR	reply[3] = { WIFI_ERR_PENDING, WIFI_ERR_PENDING, WIFI_ERR_PENDING };
+	WIFI_ERR	err = WIFI_ERR_OK;
+	uint8_t		depth = _cmdDepth;
+	uint8_t		issued, i;
+	bool		busy = false;
+
+	_idle();
+	if (!_ready())
+		return WIFI_ERR_ERROR;
+	// The commands are issued back to back up to ESP8266_SETUP_DEPTH
+	// at least. The rest would be canceled if the preceding command
+	// has already failed. The result is kept before its slot is reused.
+	if (_cmdDepth < ESP8266_SETUP_DEPTH)
+		pipeline(ESP8266_SETUP_DEPTH);
+	for (issued = 0; issued < count; issued++) {
+		if (issued && (!_vacant() || !_hopeful(handle[issued - 1])))
+			break;
+		for (i = 0; i < issued; i++)
+			if (reply[i] == WIFI_ERR_PENDING)
+				reply[i] = result(handle[i]);
+		handle[issued] = _configAsync(cmd[issued], value[issued]);
+	}
+	for (i = 0; i < issued; i++)
+		if (reply[i] == WIFI_ERR_PENDING)
+			reply[i] = wait(handle[i]);
+	_cmdDepth = depth;
+	// The module answers busy to the command arrived while processing
+	// the preceding one. The commands from the busy one are issued
+	// again one by one, and the first failure is reported.
+	for (i = 0; i < count && err == WIFI_ERR_OK; i++) {
+		if (i < issued && !busy && reply[i] != WIFI_ERR_BUSY) {
+			err = reply[i];
+			continue;
+		}
+		busy = true;
+		err = wait(_configAsync(cmd[i], value[i]));
+	}
+	return err;
+}
+/**
+ * Issue a setup command of config.
+ * @parameter	cmd		WIFI_CMD_CWMODE, WIFI_CMD_CIPMUX or WIFI_CMD_CIPMODE
+ * @parameter	value	Parameter of the command
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::_configAsync(WIFI_CMD cmd, uint8_t value) {
+	_CmdLine<SerialT, Policy>	line(_uart);
+
+	switch (cmd) {
+	case WIFI_CMD_CWMODE:
+		line.text(F(ESP8266_AT_CWMODE "="));
+		break;
+	case WIFI_CMD_CIPMUX:
+		line.text(F("AT+CIPMUX="));
+		break;
+	default:
+		line.text(F("AT+CIPMODE="));
+		break;
+	}
+	line.number(value).end();
+	return _submit(cmd, Policy::timeOut, NULL);
+}
+
+/**
+ * Connect to the WiFi access point for the station.
+ * @parameter	ssid	SSID of the access point to be connected
+ * @parameter	pwd		Pass phrase
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::join(const char *ssid, const char *pwd) {
+	_idle();
+	return wait(joinAsync(ssid, pwd));
+}
+/**
+ * Connect to the WiFi access point for the station asynchronously.
+ * @parameter	ssid		SSID of the access point to be connected
+ * @parameter	pwd			Pass phrase
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::joinAsync(const char *ssid, const char *pwd, WIFI_CALLBACK callback) {
+	return _joinAsync(ssid, pwd, NULL, callback);
+}
+/**
+ * Connect to the WiFi access point actual method.
+ * @parameter	ssid		SSID of the access point to be connected
+ * @parameter	pwd			Pass phrase
+ * @parameter	bssid		BSSID of the access point, NULL to scan
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::_joinAsync(const char *ssid, const char *pwd, const char *bssid, WIFI_CALLBACK callback) {
+	_CmdLine<SerialT, Policy>	line(_uart);
+
+	if (!_ready())
+		return WIFI_HANDLE_NONE;
+	// SSID and the pass phrase are escaped.
+	line.text(F(ESP8266_AT_CWJAP "=")).quote(ssid).put(',').quote(pwd);
+	if (bssid)
+		line.put(',').quote(bssid);
+	line.end();
+	return _submit(WIFI_CMD_CWJAP, 10000, callback);
+}
+
+/**
+ * Inquire BSSID of the joined access point asynchronously.
+ * The reply is stored to _bssid when SSID is maintained by autojoin.
+ * @return		WIFI_HANDLE	Handle of the command, WIFI_HANDLE_NONE
+ *							if the command cannot be issued now
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::_learnAsync(void) {
+	if (!_ready())
+		return WIFI_HANDLE_NONE;
+	_bssid[0] = '\0';
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CWJAP?")).end();
+	_tail()->reply = _bssid;
+	return _submit(WIFI_CMD_CWJAPQ, Policy::timeOut, NULL);
+}
+
+/**
+ * Keep the station joined to the access point.
+ * The join is issued by maintain, and it is issued again when the
+ * station is disconnected. The strings must be kept while maintained.
+ * @parameter	ssid	SSID of the access point, NULL to stop maintaining
+ * @parameter	pwd		Pass phrase
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::autojoin(const char *ssid, const char *pwd) {
+	_joinSsid = ssid;
+	_joinPwd = pwd;
+	if (!ssid) {
+		_joinState = WIFI_JOIN_OFF;
+		return;
+	}
+	_joinState = WIFI_JOIN_DOWN;
+	_joinRetries = 0;
+	_joinAt = _downAt = millis();
+	_downTiming = true;
+}
+/**
+ * Advance the rejoining.
+ * The join designates the cached BSSID at first, and the full join
+ * follows immediately if it failed. The full join is retried with the
+ * interval of ESP8266_JOIN_BACKOFF doubling up to ESP8266_JOIN_BACKOFF_MAX,
+ * and the random jitter spreads it from the half to the whole. The BSSID
+ * is learned by AT+CWJAP? after the full join without waiting for it,
+ * the station is up when the reply concludes.
+ * @return		WIFI_JOINST	State of the station
+ */
+template<class SerialT, class Policy>
+WIFI_JOINST ESP8266Driver<SerialT, Policy>::maintain(void) {
+	WIFI_ERR	err;
+	uint32_t	interval;
+
+	(void)poll();
+	switch (_joinState) {
+	case WIFI_JOIN_DOWN:
+		if ((int32_t)(millis() - _joinAt) < 0 || !_ready())
+			break;
+		_joinFast = _bssid[0] != '\0';
+		if ((_joinHandle = _joinAsync(_joinSsid, _joinPwd, _joinFast ? _bssid : NULL, NULL)) == WIFI_HANDLE_NONE)
+			break;
+		_joinStat.attempts++;
+		_joinState = WIFI_JOIN_JOINING;
+		break;
+	case WIFI_JOIN_JOINING:
+		if ((err = result(_joinHandle)) == WIFI_ERR_PENDING)
+			break;
+		if (err == WIFI_ERR_OK) {
+			if (_joinFast)
+				_joinStat.fastJoins++;
+			_joinState = _joinFast ? WIFI_JOIN_UP : WIFI_JOIN_LEARNING;
+			_joinRetries = 0;
+			_joined();
+			if (!_joinFast)
+				_joinHandle = _learnAsync();
+		} else if (_joinFast) {
+			// The access point may have moved to the other channel.
+			_joinStat.fallbacks++;
+			_bssid[0] = '\0';
+			_joinState = WIFI_JOIN_DOWN;
+			_joinAt = millis();
+		} else {
+			interval = _joinRetries < 16 ? (uint32_t)ESP8266_JOIN_BACKOFF << _joinRetries : ESP8266_JOIN_BACKOFF_MAX;
+			if (interval > ESP8266_JOIN_BACKOFF_MAX)
+				interval = ESP8266_JOIN_BACKOFF_MAX;
+			_joinRetries++;
+			_joinState = WIFI_JOIN_DOWN;
+			_joinAt = millis() + interval / 2 + random(interval / 2 + 1);
+		}
+		break;
+	case WIFI_JOIN_LEARNING:
+		// AT+CWJAP? waits for the line if the other command occupies it.
+		if (_joinHandle == WIFI_HANDLE_NONE) {
+			_joinHandle = _learnAsync();
+			break;
+		}
+		if (result(_joinHandle) == WIFI_ERR_PENDING)
+			break;
+		// The station is up even if BSSID was not learned, the next
+		// join is the full one then.
+		_joinState = WIFI_JOIN_UP;
+		break;
+	default:
+		break;
+	}
+	return _joinState;
+}
+/**
+ * Measure the time from the disconnection until GOT IP.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_joined(void) {
+	uint32_t	elapsed;
+
+	if (!_downTiming)
+		return;
+	_downTiming = false;
+	elapsed = millis() - _downAt;
+	_joinStat.recoveries++;
+	_joinStat.timeToIp = elapsed;
+	_joinStat.totalTimeToIp += elapsed;
+	if (elapsed > _joinStat.maxTimeToIp)
+		_joinStat.maxTimeToIp = elapsed;
+}
+/**
+ * Get BSSID of the last joined access point.
+ * It is learned by AT+CWJAP? with SSID maintained by autojoin.
+ * @return		BSSID, empty if unknown
+ */
+template<class SerialT, class Policy>
+const char *ESP8266Driver<SerialT, Policy>::bssid(void) {
+	return _bssid;
+}
+/**
+ * Get the statistics of the rejoining.
+ * The average time until GOT IP is totalTimeToIp / recoveries.
+ * @return		WIFI_JOINSTAT
+ */
+template<class SerialT, class Policy>
+WIFI_JOINSTAT ESP8266Driver<SerialT, Policy>::joinStat(void) {
+	return _joinStat;
+}
+
+/**
+ * Get IP address and report resulted IP address string.
+ * @parameter	mode	<code>WIFI_MODE</code> enumeration value
+ *						should be announce
+ * @return		IP address string
+ */
+template<class SerialT, class Policy>
+char *ESP8266Driver<SerialT, Policy>::ip(WIFI_MODE mode) {
+	_idle();
+	if (!_ready())
+		return NULL;
+	// IP addresses as the client and the SoftAP are taken from
+	// the response lines. +CIFSR:APIP is not responded without
+	// the SoftAP mode, it remains empty.
+	_ipAddrSta[0] = '\0';
+	_ipAddrAp[0] = '\0';
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIFSR")).end();
+	(void)wait(_submit(WIFI_CMD_CIFSR, Policy::timeOut, NULL));
+
+	// Dispatching WiFi connection state to decide which the result.
+	switch (mode) {
+	case WIFI_MODE_STA:
+		return _ipAddrSta;
+	case WIFI_MODE_AP:
+		return _ipAddrAp;
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Disconnect from WiFi access point.
+ * @return	WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::disconnect(void) {
+	_idle();
+	return wait(disconnectAsync());
+}
+/**
+ * Disconnect from WiFi access point asynchronously.
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::disconnectAsync(WIFI_CALLBACK callback) {
+	if (!_ready())
+		return WIFI_HANDLE_NONE;
+	// The station is no longer maintained.
+	_joinState = WIFI_JOIN_OFF;
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CWQAP")).end();
+	return _submit(WIFI_CMD_CWQAP, Policy::timeOut, callback);
+}
+
+/**
+ * Inquire current WiFi connection status.
+ * @parameter	ssid	SSID of the WiFi AP
+ * @return		True	Connected
+ *				False	Not connected
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::isConnect(char *ssid) {
+	_idle();
+	if (!_ready())
+		return false;
+	// SSID is stored by the +CWJAP response line.
+	ssid[0] = '\0';
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CWJAP?")).end();
+	_tail()->reply = ssid;
+	return wait(_submit(WIFI_CMD_CWJAPQ, Policy::timeOut, NULL)) == WIFI_ERR_OK && ssid[0];
+}
+
+/**
+ * Scan the access points and keep the strongest ones.
+ * Each +CWLAP line is parsed as it arrives, so the memory is bounded by
+ * the list regardless of the number of the access points around.
+ * @parameter	list		Array of the entries to be filled
+ * @parameter	capacity	Number of the entries of the array
+ * @parameter	filter		Conditions of the entry to be kept, NULL for any
+ * @return		Number of the kept entries in descending order of RSSI,
+ *				-1 if the scan failed
+ */
+template<class SerialT, class Policy>
+int8_t ESP8266Driver<SerialT, Policy>::scan(WIFI_AP *list, uint8_t capacity, const WIFI_SCANFILTER *filter) {
+	_CmdLine<SerialT, Policy>	line(_uart);
+	WIFI_SCAN	scan;
+	WIFI_AP		entry;
+	uint8_t		n;
+
+	_idle();
+	if (!_ready())
+		return -1;
+	// The fields not needed are trimmed once, the firmware without
+	// AT+CWLAPOPT is tried only once either.
+	if (!_lapopt) {
+		line.text(F("AT+CWLAPOPT=1,")).number(ESP8266_CWLAP_MASK).end();
+		(void)wait(_submit(WIFI_CMD_GENERIC, Policy::timeOut, NULL));
+		_lapopt = true;
+		if (!_ready())
+			return -1;
+	}
+	scan.list = list;
+	scan.capacity = capacity > 127 ? 127 : capacity;
+	scan.count = 0;
+	scan.seen = 0;
+	scan.filter = filter;
+	line.text(F("AT+CWLAP"));
+	// The module itself narrows down to the SSID.
+	if (filter && filter->ssid)
+		line.put('=').quote(filter->ssid);
+	line.end();
+	_tail()->reply = &scan;
+	if (wait(_submit(WIFI_CMD_CWLAP, ESP8266_SCAN_TIMEOUT, NULL)) != WIFI_ERR_OK)
+		return -1;
+	// Sort the heap, the weakest root goes to the tail one by one.
+	for (n = scan.count; n > 1; ) {
+		entry = list[0];
+		list[0] = list[--n];
+		list[n] = entry;
+		ESP8266Detail::_heapDown(list, n, 0);
+	}
+	return (int8_t)scan.count;
+}
+
+/**
+ * Get current WiFi connection status.
+ * @return	WIFI_STATUS	The following values indicating the connection state.
+ *		<code>WIFI_STATUS_GOTIP</code> IP address assigned
+ *		<code>WIFI_STATUS_CONN</code> WiFi connected
+ *		<code>WIFI_STATUS_DISCONN</code> WiFi disconnected
+ *		<code>WIFI_STATUS_NOTCONN</code> WiFi did not connected
+ */
+template<class SerialT, class Policy>
+WIFI_STATUS ESP8266Driver<SerialT, Policy>::status(void) {
+	WIFI_STATUS	sta = WIFI_STATUS_UNKNOWN;
+
+	_idle();
+	if (!_ready())
+		return sta;
+	// The status is stored by the STATUS response line.
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPSTATUS")).end();
+	_tail()->reply = &sta;
+	(void)wait(_submit(WIFI_CMD_CIPSTATUS, Policy::timeOut, NULL));
+	return sta;
+}
+
+/**
+ * Setup access connection topology.
+ * Set the ESP8266 mode of making up the connection topology.
+ * @parameter	conn	The following values indicating the connection topology.
+ *	<code>WIFI_CONN_CLIENT</code> Client access
+ *	<code>WIFI_CONN_SERVER</code> Server connection
+ *	<code>WIFI_CONN_BROADCAST</code> Client access by UDP connection
+ * @parameter	protocol	The following values indicating the connection type.
+ *	<code>WIFI_PRO</code>	Transfer protocol to be used in this connection
+ * @parameter	mux			The following values indicating the multiple connection.
+ *	<code>WIFI_MUX</code>	Transfer protocol to be used in this connection
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::setup(WIFI_CONN conn, WIFI_PRO protocol, WIFI_MUX mux) {
+	WIFI_ERR	err;
+
+	switch (conn) {
+	case WIFI_CONN_CLIENT:
+		err = config(WIFI_MODE_STA, mux, WIFI_IPMODE_NODESC);
+		break;
+	case WIFI_CONN_SERVER:
+		err = config(WIFI_MODE_AP, WIFI_MUX_MULTI, WIFI_IPMODE_NODESC);
+		break;
+	case WIFI_CONN_PEER:
+		err = config(WIFI_MODE_APSTA, mux, WIFI_IPMODE_NODESC);
+		break;
+	default:
+		err = WIFI_ERR_OK;
+		break;
+	}
+	if (err == WIFI_ERR_OK)
+		_protocol = protocol;
+	return err;
+}
+
+/**
+ * Start IP connection for server side with passive SYN.
+ * Start the server side of the IP connection executed by CIPSERVER command.
+ * @parameter	port		Port number
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::server(uint16_t port) {
+	_idle();
+	return wait(serverAsync(port));
+}
+/**
+ * Start IP connection for server side asynchronously.
+ * @parameter	port		Port number
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::serverAsync(uint16_t port, WIFI_CALLBACK callback) {
+	if (!_ready())
+		return WIFI_HANDLE_NONE;
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPSERVER=1,")).number(port).end();
+	return _submit(WIFI_CMD_CIPSERVER, 10000, callback);
+}
+
+/**
+ * Set the time-out of the server by AT+CIPSTO.
+ * The client which has been idle over the time-out is closed by
+ * ESP8266, and it is notified to onClose. It is available after
+ * the server started.
+ * @parameter	timeOut	Time-out with second unit up to 7200, 0 never closes
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::serverTimeout(uint16_t timeOut) {
+	_idle();
+	if (!_ready())
+		return WIFI_ERR_ERROR;
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPSTO=")).number(timeOut).end();
+	return wait(_submit(WIFI_CMD_CIPSTO, Policy::timeOut, NULL));
+}
+
+/**
+ * Set the handler of the client connection.
+ * @parameter	handler	Handler called with the connection ID
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::onConnect(WIFI_EVENT handler) {
+	_onConnect = handler;
+}
+/**
+ * Set the handler of the received data.
+ * The handler reads the data by read with the connection ID, it is
+ * called again at the next serve if the data remains.
+ * @parameter	handler	Handler called with the connection ID and
+ *						the available length
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::onData(WIFI_DATA handler) {
+	_onData = handler;
+}
+/**
+ * Set the handler of the closing.
+ * @parameter	handler	Handler called with the connection ID
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::onClose(WIFI_EVENT handler) {
+	_onClose = handler;
+}
+
+/**
+ * Service the clients of the server.
+ * It dispatches the events of each connection ID in turn, and the
+ * first connection ID rotates at every call so that a busy client
+ * does not starve the others. The handlers are called from here
+ * instead of poll, so they can issue the blocking methods such as
+ * send and close.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::serve(void) {
+	WIFI_CLIENT	*client;
+	uint8_t		i, channel, events;
+	uint16_t	length;
+
+	(void)poll();
+	for (i = 0; i < ESP8266_RX_CHANNELS; i++) {
+		channel = (_serveNext + i) % ESP8266_RX_CHANNELS;
+		client = &_client[channel];
+		events = client->events;
+		client->events = 0;
+		// The closing belongs to the previous client if reconnected.
+		if ((events & WIFI_EVENT_CLOSE) && client->connected) {
+			events &= ~WIFI_EVENT_CLOSE;
+			if (_onClose)
+				_onClose(channel);
+		}
+		if ((events & WIFI_EVENT_CONNECT) && _onConnect)
+			_onConnect(channel);
+		// The data arrived before the closing is delivered first.
+		// The link which the sketch connected is left to its read.
+		if (client->accepted && (length = _rx[channel].count) != 0 && _onData)
+			_onData(channel, length);
+		if (events & WIFI_EVENT_CLOSE) {
+			if (_onClose)
+				_onClose(channel);
+			client->accepted = false;
+		}
+	}
+	_serveNext = (_serveNext + 1) % ESP8266_RX_CHANNELS;
+}
+
+/**
+ * Get the state of the client.
+ * The context member is free for the sketch to keep the state of
+ * the client.
+ * @parameter	channel	Connection ID
+ * @return		WIFI_CLIENT, NULL for the invalid connection ID
+ */
+template<class SerialT, class Policy>
+WIFI_CLIENT *ESP8266Driver<SerialT, Policy>::client(int8_t channel) {
+	return channel >= 0 && channel < ESP8266_RX_CHANNELS ? &_client[channel] : NULL;
+}
+/**
+ * Start the single IP connection for client side with active OPEN.
+ * @parameter	address	IP address of the destination
+ * @parameter	port	Port number as a connection
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::connect(char *address, uint16_t port) {
+	return _connect(-1, _protocol, address, port);
+}
+/**
+ * Start IP connection with connection ID for multi connection.
+ * @parameter	channel	Connection ID
+ * @parameter	address	IP address of the destination
+ * @parameter	port	Port number as a connection
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::connect(int8_t channel, char *address, uint16_t port) {
+	return _connect(channel, _protocol, address, port);
+}
+/**
+ * Start IP connection asynchronously.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	address		IP address of the destination
+ * @parameter	port		Port number as a connection
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::connectAsync(int8_t channel, char *address, uint16_t port, WIFI_CALLBACK callback) {
+	(void)_dnsLookup(address);
+	return _connectAsync(channel, _protocol, address, port, callback);
+}
+/**
+ * Start IP connection actual method.
+ * @parameter	protocol	Connection protocol by <code>WIFI_PRO</code> enumeration value.
+ * @parameter	channel		The connection id to be connected,
+ *	If <code>-1</code> is specified then 0 would be assigned to the connection id.
+ * @parameter	address		IP address to be connected.
+ * @parameter	port		Port number.
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::_connect(int8_t channel, WIFI_PRO protocol, char *address, uint16_t port) {
+	_idle();
+	// Resolve the host in advance to be connected by the address.
+	if (!_dnsLookup(address))
+		(void)_resolve(address);
+	return wait(_connectAsync(channel, protocol, address, port, NULL));
+}
+/**
+ * Start IP connection actual method without waiting for the reply.
+ * The command would be concluded with <code>WIFI_ERR_CONNECT</code>
+ * when the connection established.
+ * @parameter	protocol	Connection protocol by <code>WIFI_PRO</code> enumeration value.
+ * @parameter	channel		The connection id to be connected,
+ *	If <code>-1</code> is specified then 0 would be assigned to the connection id.
+ * @parameter	address		IP address to be connected.
+ * @parameter	port		Port number.
+ * @parameter	callback	Completion notification
+ * @parameter	localPort	Local port of UDP, 0 if not bound
+ * @return		WIFI_HANDLE
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::_connectAsync(int8_t channel, WIFI_PRO protocol, char *address, uint16_t port, WIFI_CALLBACK callback, uint16_t localPort) {
+	WIFI_DNSENTRY	*entry;
+	_CmdLine<SerialT, Policy>	line(_uart);
+
+	if (!_ready())
+		return WIFI_HANDLE_NONE;
+	// The cached address is dropped if the connection failed.
+	if ((entry = _dnsFind(address)) != NULL) {
+		address = entry->ip;
+		entry->usedAt = millis();
+	}
+	_tail()->reply = entry;
+	_tail()->channel = channel;
+	if (channel < ESP8266_RX_CHANNELS)
+		_rx[channel < 0 ? 0 : channel].datagram = protocol == WIFI_PRO_UDP;
+
+	// Start connection string building to order with ESP3266
+	// by CIPSTART command.
+	line.text(F("AT+CIPSTART="));
+	if (channel >= 0)
+		line.number(channel).put(',');
+	// Dispatch protocol specification
+	switch (protocol) {
+	case WIFI_PRO_TCP:
+		line.text(F("\"TCP\","));
+		break;
+	case WIFI_PRO_UDP:
+		line.text(F("\"UDP\","));
+		break;
+	}
+	// Append port number and throw to ESP8266
+	line.quote(address).put(',').number(port);
+	// UDP local port with the mode 2, the remote end follows the sender.
+	if (localPort)
+		line.put(',').number(localPort).text(F(",2"));
+	line.end();
+	// The reply continues up to the result code following CONNECT.
+	return _submit(WIFI_CMD_CIPSTART, 10000, callback);
+}
+
+/**
+ * Send data with no connection ID specified.
+ * @parameter	data	sending data with null termination
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::send(const uint8_t *data) {
+	return _send(-1, data);
+}
+/**
+ * Send data with connection ID specified.
+ * @parameter	channel	Connection ID to be used for the transmission
+ * @parameter	data	sending data with null termination
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::send(int8_t channel, const uint8_t *data) {
+	return _send(channel, data);
+}
+/**
+ * Sending data along with making a connection establishment.
+ * @parameter	channel	Connection ID to be used for the transmission
+ * @parameter	address	IP address to be connected
+ * @parameter	port	Port number
+ * @parameter	data	sending data with null termination
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::send(int8_t channel, char *address, uint16_t port, const uint8_t *data) {
+	WIFI_ERR	err;
+
+	// Establish connection with the listener on UDP protocol
+	if ((err = _connect(channel, _protocol, address, port)) != WIFI_ERR_CONNECT)
+		return err;
+
+	// Transmission data
+	return _send(channel, data);
+}
+/**
+ * Data sending actual method.
+ * @parameter	channel	Connection ID to send
+ * @parameter	buffer	Address that stores data for transmission
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::_send(int8_t channel, const uint8_t *buffer) {
+	_idle();
+	return wait(sendAsync(channel, buffer));
+}
+/**
+ * Send the binary data of the specified length.
+ * The data may contain null characters.
+ * @parameter	channel	Connection ID, -1 for the single connection
+ * @parameter	data	Sending data
+ * @parameter	length	Sending data length
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::send(int8_t channel, const uint8_t *data, uint16_t length) {
+	_idle();
+	return wait(sendAsync(channel, data, length));
+}
+/**
+ * Send the data gathered from the segments by one transmission.
+ * The total length of the segments is announced by one CIPSEND, and
+ * then each segment is written out in sequence.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	segment		Array of the segments
+ * @parameter	segments	Number of the segments
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::send(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments) {
+	_idle();
+	return wait(sendAsync(channel, segment, segments));
+}
+/**
+ * Send the long data produced by the callback.
+ * The data is split into the segments of ESP8266_SEND_MAX, and the
+ * producer is called at the prompt of each CIPSEND to fill the small
+ * buffer on the stack, so that the whole data never resides in RAM.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	length		Total length of the data
+ * @parameter	producer	Producer of the data
+ * @parameter	progress	Progress notification, NULL if not needed
+ * @return		WIFI_ERR	WIFI_ERR_OK if all the data were sent
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::sendStream(int8_t channel, uint32_t length, WIFI_PRODUCER producer, WIFI_PROGRESS progress) {
+	memset(&_stream, 0, sizeof(_stream));
+	_stream.producer = producer;
+	return _sendStream(channel, length, progress);
+}
+/**
+ * Send the long data read from the stream such as a file.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	length		Total length of the data
+ * @parameter	source		Stream to be read
+ * @parameter	progress	Progress notification, NULL if not needed
+ * @return		WIFI_ERR	WIFI_ERR_OK if all the data were sent
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::sendStream(int8_t channel, uint32_t length, Stream &source, WIFI_PROGRESS progress) {
+	memset(&_stream, 0, sizeof(_stream));
+	_stream.source = &source;
+	return _sendStream(channel, length, progress);
+}
+/**
+ * Send the long data gathered from the segments.
+ * The segment can be longer than ESP8266_SEND_MAX, such as a large
+ * blob in PROGMEM. The segments are split and joined regardless of
+ * their boundaries.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	segment		Array of the segments
+ * @parameter	segments	Number of the segments
+ * @parameter	progress	Progress notification, NULL if not needed
+ * @return		WIFI_ERR	WIFI_ERR_OK if all the data were sent
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::sendStream(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments, WIFI_PROGRESS progress) {
+	uint32_t	length = 0;
+	uint8_t		i;
+
+	for (i = 0; i < segments; i++)
+		length += segment[i].length;
+	memset(&_stream, 0, sizeof(_stream));
+	_stream.segment = segment;
+	_stream.segments = segments;
+	return _sendStream(channel, length, progress);
+}
+/**
+ * Get the result of the last large transmission.
+ * @return		WIFI_STREAMSTAT
+ */
+template<class SerialT, class Policy>
+WIFI_STREAMSTAT ESP8266Driver<SerialT, Policy>::streamStat(void) {
+	return _streamStat;
+}
+/**
+ * Large transmission actual method.
+ * Each segment is announced by CIPSEND with the segment which has no
+ * data, and it is filled from the stream at the prompt. The firmware
+ * answers busy to the command during the sending, so the next CIPSEND
+ * is issued as soon as SEND OK of the previous segment arrives.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	length		Total length of the data
+ * @parameter	progress	Progress notification, NULL if not needed
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::_sendStream(int8_t channel, uint32_t length, WIFI_PROGRESS progress) {
+	WIFI_SEGMENT	*marker;
+	WIFI_ERR	err = WIFI_ERR_OK;
+	uint32_t	startAt;
+	uint16_t	n;
+
+	memset(&_streamStat, 0, sizeof(_streamStat));
+	_streamStat.total = length;
+	_idle();
+	startAt = millis();
+	while (_streamStat.sent < length) {
+		n = length - _streamStat.sent < ESP8266_SEND_MAX ? length - _streamStat.sent : ESP8266_SEND_MAX;
+		marker = &_tail()->single;
+		marker->data = NULL;
+		marker->length = n;
+		marker->progmem = false;
+		if ((err = wait(sendAsync(channel, marker, 1))) != WIFI_ERR_OK)
+			break;
+		_streamStat.segments++;
+		// The module took the padding as the data of the segment, so
+		// the link is aborted not to pass it as the complete stream.
+		if (_stream.underrun) {
+			close(channel);
+			err = WIFI_ERR_ERROR;
+			break;
+		}
+		_streamStat.sent += n;
+		if (progress)
+			progress(_streamStat.sent, length);
+	}
+	_streamStat.elapsed = millis() - startAt;
+	// The integer division avoids the overflow of sent * 1000.
+	if (_streamStat.elapsed)
+		_streamStat.throughput = _streamStat.sent / _streamStat.elapsed * 1000
+			+ _streamStat.sent % _streamStat.elapsed * 1000 / _streamStat.elapsed;
+	memset(&_stream, 0, sizeof(_stream));
+	return err;
+}
+/**
+ * Bind the local port to the connection for the datagram.
+ * The connection is started by CIPSTART of UDP with the mode 2, so
+ * the remote end follows the sender of the last datagram. The remote
+ * end of each datagram is reported by AT+CIPDINFO=1, it is applied
+ * with the first binding.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	localPort	Local port to be bound
+ * @parameter	host		Initial remote address, ESP8266_UDP_ANY by default
+ * @parameter	port		Initial remote port
+ * @return		WIFI_ERR	WIFI_ERR_CONNECT when bound
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::bind(int8_t channel, uint16_t localPort, const char *host, uint16_t port) {
+	WIFI_ERR	err;
+
+	_idle();
+	if (!_dinfo) {
+		if (!_ready())
+			return WIFI_ERR_ERROR;
+		_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPDINFO=1")).end();
+		if ((err = wait(_submit(WIFI_CMD_CIPDINFO, Policy::timeOut, NULL))) != WIFI_ERR_OK)
+			return err;
+		_dinfo = true;
+	}
+	return wait(_connectAsync(channel, WIFI_PRO_UDP, (char *)host, port, NULL, localPort));
+}
+/**
+ * Send the datagram to the destination through the bound connection.
+ * The destination is specified by AT+CIPSEND without reconnecting.
+ * @parameter	channel	Connection ID, -1 for the single connection
+ * @parameter	host	Destination address or host name
+ * @parameter	port	Destination port
+ * @parameter	data	Data of the datagram
+ * @parameter	length	Length of the data
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::sendTo(int8_t channel, const char *host, uint16_t port, const uint8_t *data, uint16_t length) {
+	_idle();
+	if (!_dnsLookup(host))
+		(void)_resolve(host);
+	return wait(sendToAsync(channel, host, port, data, length));
+}
+/**
+ * Send the datagrams back to back.
+ * The host names are resolved in advance, and then the next CIPSEND
+ * follows SEND OK of the previous datagram immediately.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	datagram	Array of the datagrams
+ * @parameter	count		Number of the datagrams
+ * @return		Number of the sent datagrams, it stops at the failure
+ */
+template<class SerialT, class Policy>
+uint8_t ESP8266Driver<SerialT, Policy>::sendTo(int8_t channel, const WIFI_DATAGRAM *datagram, uint8_t count) {
+	uint8_t		i;
+
+	_idle();
+	for (i = 0; i < count; i++)
+		if (!_dnsLookup(datagram[i].host))
+			(void)_resolve(datagram[i].host);
+	for (i = 0; i < count; i++)
+		if (wait(sendToAsync(channel, datagram[i].host, datagram[i].port, datagram[i].data, datagram[i].length)) != WIFI_ERR_OK)
+			break;
+	return i;
+}
+/**
+ * Send data asynchronously.
+ * The data is written out at the prompt of CIPSEND in the poll
+ * method, the buffer must be kept until the command concludes.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	buffer		Address that stores data for transmission
+ *							with null termination
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command,
+ *							WIFI_HANDLE_NONE with the empty data
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::sendAsync(int8_t channel, const uint8_t *buffer, WIFI_CALLBACK callback) {
+	const uint8_t	*sp = buffer;
+	uint16_t	s_size = 0;
+
+	// Determine sending length
+	while (*sp++)
+		s_size++;
+	return sendAsync(channel, buffer, s_size, callback);
+}
+/**
+ * Send the binary data of the specified length asynchronously.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	data		Sending data
+ * @parameter	length		Sending data length
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command,
+ *							WIFI_HANDLE_NONE with the empty data
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::sendAsync(int8_t channel, const uint8_t *data, uint16_t length, WIFI_CALLBACK callback) {
+	WIFI_SEGMENT	*single = &_tail()->single;
+
+	if (!_ready(true))
+		return WIFI_HANDLE_NONE;
+	single->data = data;
+	single->length = length;
+	single->progmem = false;
+	return sendAsync(channel, single, 1, callback);
+}
+/**
+ * Send the data gathered from the segments asynchronously.
+ * The segments and their data must be kept until the command concludes.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	segment		Array of the segments
+ * @parameter	segments	Number of the segments
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command,
+ *	WIFI_HANDLE_NONE with the empty data or exceeding ESP8266_SEND_MAX
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::sendAsync(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments, WIFI_CALLBACK callback) {
+	return _sendAsync(channel, segment, segments, NULL, 0, callback);
+}
+/**
+ * Send the datagram asynchronously.
+ * The host name is replaced with the cached address.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	host		Destination address
+ * @parameter	port		Destination port
+ * @parameter	data		Data of the datagram
+ * @parameter	length		Length of the data
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command,
+ *							WIFI_HANDLE_NONE with the empty data
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::sendToAsync(int8_t channel, const char *host, uint16_t port, const uint8_t *data, uint16_t length, WIFI_CALLBACK callback) {
+	WIFI_SEGMENT	*single = &_tail()->single;
+	WIFI_DNSENTRY	*entry;
+
+	if (!_ready(true))
+		return WIFI_HANDLE_NONE;
+	if ((entry = _dnsFind(host)) != NULL) {
+		host = entry->ip;
+		entry->usedAt = millis();
+	}
+	single->data = data;
+	single->length = length;
+	single->progmem = false;
+	return _sendAsync(channel, single, 1, host, port, callback);
+}
+/**
+ * Send the segments actual method.
+ * @parameter	channel		Connection ID, -1 for the single connection
+ * @parameter	segment		Array of the segments
+ * @parameter	segments	Number of the segments
+ * @parameter	host		Destination address of UDP, NULL for the connected end
+ * @parameter	port		Destination port of UDP
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::_sendAsync(int8_t channel, const WIFI_SEGMENT *segment, uint8_t segments, const char *host, uint16_t port, WIFI_CALLBACK callback) {
+	uint32_t	s_size = 0;
+	uint8_t		i;
+	_CmdLine<SerialT, Policy>	line(_uart);
+
+	// The data follows the command, no other command can be interleaved.
+	if (!_ready(true))
+		return WIFI_HANDLE_NONE;
+	// Determine sending length
+	for (i = 0; i < segments; i++)
+		s_size += segment[i].length;
+	if (s_size == 0 || s_size > ESP8266_SEND_MAX)
+		return WIFI_HANDLE_NONE;
+
+	// Start forwarding
+	line.text(F("AT+CIPSEND="));
+	if (channel >= 0)
+		// Sending ID specified
+		line.number(channel).put(',');
+	line.number(s_size);
+	// The datagram is addressed to the destination.
+	if (host)
+		line.put(',').quote(host).put(',').number(port);
+	line.end();
+
+	// Send request ended,
+	// the data would be forwarded at the prompt.
+	return _submit(WIFI_CMD_CIPSEND, Policy::timeOut, callback, segment, segments);
+}
+/**
+ * Write out the segments to ESP8266.
+ * The segment in the program memory is written through a small
+ * buffer on the stack.
+ * @parameter	segment		Array of the segments
+ * @parameter	segments	Number of the segments
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_write(const WIFI_SEGMENT *segment, uint8_t segments) {
+	uint8_t		chunk[32];
+	const uint8_t	*sp;
+	uint16_t	length, n;
+
+	while (segments--) {
+		sp = (const uint8_t *)segment->data;
+		length = segment->length;
+		if (!sp)
+			_produce(length);
+		else if (segment->progmem)
+			while (length) {
+				n = length < sizeof(chunk) ? length : sizeof(chunk);
+				memcpy_P(chunk, sp, n);
+				ESP8266Detail::_clearToSend<Policy>();
+				_uart->write(chunk, n);
+				Policy::tap(WIFI_TAP_TX, WIFI_TAPLV_TRACE, chunk, n);
+				sp += n;
+				length -= n;
+			}
+		else if (length) {
+			ESP8266Detail::_clearToSend<Policy>();
+			_uart->write(sp, length);
+			Policy::tap(WIFI_TAP_TX, WIFI_TAPLV_TRACE, sp, length);
+		}
+		ESP8266_Metric(_stats.sent += segment->length);
+		segment++;
+	}
+}
+/**
+ * Write out the data of the large transmission from its source.
+ * The length was announced by CIPSEND and the module takes the data
+ * up to it before any command, so the rest is filled with zero when
+ * the source runs dry. The transmission is marked as the underrun
+ * and the link is aborted after the segment.
+ * @parameter	length		Length to be written out
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_produce(uint16_t length) {
+	uint8_t		chunk[32];
+	const uint8_t	*sp;
+	uint16_t	n, got;
+
+	while (length) {
+		n = length < sizeof(chunk) ? length : sizeof(chunk);
+		sp = chunk;
+		got = 0;
+		// Skip the empty and the exhausted segments.
+		while (_stream.segments && _stream.offset >= _stream.segment->length) {
+			_stream.segment++;
+			_stream.segments--;
+			_stream.offset = 0;
+		}
+		if (_stream.producer)
+			got = _stream.producer(chunk, n, _stream.written);
+		else if (_stream.source)
+			got = _stream.source->readBytes(chunk, n);
+		else if (_stream.segments) {
+			sp = (const uint8_t *)_stream.segment->data + _stream.offset;
+			got = _stream.segment->length - _stream.offset;
+			if (_stream.segment->progmem) {
+				if (got > n)
+					got = n;
+				memcpy_P(chunk, sp, got);
+				sp = chunk;
+			} else if (got > length)
+				// The data in RAM is written out directly.
+				got = length;
+			_stream.offset += got;
+		}
+		if (got == 0 || (sp == chunk && got > n)) {
+			memset(chunk, 0, n);
+			sp = chunk;
+			got = n;
+			_stream.underrun = true;
+		}
+		ESP8266Detail::_clearToSend<Policy>();
+		_uart->write(sp, got);
+		Policy::tap(WIFI_TAP_TX, WIFI_TAPLV_TRACE, sp, got);
+		_stream.written += got;
+		length -= got;
+	}
+}
+
+/**
+ * Start listening at the specified connection, and then stores
+ * the received data to the buffer. If the connection mode is
+ * single, specify -1 to the channel argument.
+ * @parameter	channel	connection ID
+ * @parameter	buffer	Buffer to store the received data that
+ *						header has been excluded '+PD:n'
+ * @parameter	size	Buffer size
+ * @parameter	timeOut	Time out scale, 0 without time-out
+ * @return		Stored data length, it is limited to the buffer size
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::receive(uint8_t *buffer, uint16_t size, uint32_t timeOut) {
+	return receive(-1, buffer, size, timeOut);
+}
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::receive(int8_t channel, uint8_t *buffer, uint16_t size, uint32_t timeOut) {
+	uint32_t	startAt;
+	int16_t		wlen, rlen = 0;
+	bool		cont;
+
+	// Extract a length of receiving data.
+	if ((wlen = listen(channel, timeOut)) > 0) {
+		// The data held by ESP8266 is pulled in the passive receive mode,
+		// the data which has arrived before switching is read at first.
+		if (_passive && !_rx[_rxChannel].count)
+			return _pull(channel >= 0 ? channel : _passiveId ? (int8_t)_rxChannel : -1, buffer, size);
+		// Start the receiving by set the data length. 
+		if ((uint16_t)wlen > size)
+			wlen = size;
+		startAt = millis();
+		do {
+			// Take out the data arrived at the connection found by listen.
+			rlen += read((int8_t)_rxChannel, buffer + rlen, wlen - rlen);
+			// Measure the occurrence of time-out.
+			// A parameter as timeOut is 0, ignore time-out.
+			cont = timeOut ? millis() - startAt < timeOut : true;
+		} while (rlen < wlen && cont);
+	}
+	return rlen;
+}
+
+/**
+ * Starts the listening from selected connection. If the connection
+ * mode is single, specify -1 to the channel argument. When
+ * the reception starts it will analyze the +IPAD identifier,
+ * and returns data length necessary for receiving. Wait for
+ * the reception indefinitely when give zero to timeOut argument.
+ * If a timeout occurs return value will be zero.
+ * Specifying -1 in multiple connection, it listens to all connections
+ * and the connection which received the data would be read by read().
+ * @parameter	channel	connection ID
+ * @parameter	timeOut Time out scale, 0 without time-out
+ * @return		The length of the data to be received
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::listen(uint32_t timeOut) {
+	return listen(-1, timeOut);
+}
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::listen(int8_t channel, uint32_t timeOut) {
+	uint32_t	startAt;					// receiving start time for timeout measure
+	int8_t		rxCh;
+	bool		cont;						// ignore timeout
+
+	// To save the start time in order to measure the time-out.
+	startAt = millis();
+	do {
+		// The received data is sorted by poll to each connection.
+		(void)poll();
+		if ((rxCh = _pending(channel)) >= 0) {
+			_rxChannel = (uint8_t)rxCh;
+			return (int16_t)_rx[rxCh].pending;
+		}
+		// timeOut argument zero to disable time-out.
+		cont = timeOut ? (millis() - startAt < timeOut) : true;
+	} while (cont);
+	return 0;
+}
+
+/**
+ * Get the number of bytes available for reading from ESP8266.
+ * This is data that's already arrived at the connection which
+ * has been found by listen.
+ * @return		The number of bytes available to read
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::available(void) {
+	return available((int8_t)_rxChannel);
+}
+/**
+ * Get the number of bytes available for reading from the specified
+ * connection. -1 to the channel for the single connection.
+ * @parameter	channel	connection ID
+ * @return		The number of bytes available to read
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::available(int8_t channel) {
+	if (channel >= ESP8266_RX_CHANNELS)
+		return 0;
+	(void)poll();
+	return (int16_t)_rx[channel < 0 ? 0 : channel].count;
+}
+
+/**
+ * Return a character that was received from ESP8266.
+ * It reads from the connection which has been found by listen.
+ * @return		The character read, or -1 if none is available
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::read(void) {
+	uint8_t	c;
+
+	return read((int8_t)_rxChannel, &c, 1) ? (int16_t)c : -1;
+}
+/**
+ * Read the received data of the specified connection to the buffer.
+ * It takes out only the data which has already arrived.
+ * @parameter	channel	connection ID, -1 for the single connection
+ * @parameter	buffer	Buffer to store the received data
+ * @parameter	size	Buffer size
+ * @return		Stored data length
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::read(int8_t channel, uint8_t *buffer, uint16_t size) {
+	if (channel >= ESP8266_RX_CHANNELS)
+		return 0;
+	(void)poll();
+	return (int16_t)_take(&_rx[channel < 0 ? 0 : channel], buffer, size);
+}
+/**
+ * Receive a datagram with its remote end.
+ * The datagram is taken out after it arrived entirely, and the part
+ * exceeding the buffer is discarded. The datagram which arrived while
+ * ESP8266_RX_FRAMES datagrams are held is discarded, and the datagram
+ * longer than ESP8266_RX_BUFF_SIZE is truncated to it.
+ * @parameter	channel	Connection ID, -1 for the single connection
+ * @parameter	buffer	Buffer to store the datagram
+ * @parameter	size	Buffer size
+ * @parameter	host	Remote address of 16 bytes, NULL if not needed
+ * @parameter	port	Remote port, NULL if not needed
+ * @return		Stored length, 0 if no datagram has arrived
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::recvFrom(int8_t channel, uint8_t *buffer, uint16_t size, char *host, uint16_t *port) {
+	WIFI_RXBUF	*rx;
+	WIFI_FRAME	frame;
+	uint16_t	rlen;
+
+	if (channel >= ESP8266_RX_CHANNELS)
+		return 0;
+	(void)poll();
+	rx = &_rx[channel < 0 ? 0 : channel];
+	if (!rx->frames)
+		return 0;
+	frame = rx->frame[0];
+	rlen = _take(rx, buffer, frame.length < size ? frame.length : size);
+	if (rlen < frame.length)
+		(void)_take(rx, NULL, frame.length - rlen);
+	if (host)
+		ESP8266Detail::_dotted(host, frame.ip);
+	if (port)
+		*port = frame.port;
+	return (int16_t)rlen;
+}
+
+/**
+ * Switch the passive receive mode by AT+CIPRECVMODE.
+ * In the passive mode, ESP8266 holds the received data and announces
+ * only its length. listen reports the held length and receive pulls
+ * the data by AT+CIPRECVDATA, so the sketch paces the receiving and
+ * the large download never overruns the small buffers.
+ * @parameter	enable	true for the passive mode, false for the active mode
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::passive(bool enable) {
+	WIFI_ERR	err;
+	uint8_t		i;
+
+	_idle();
+	if (!_ready())
+		return WIFI_ERR_ERROR;
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPRECVMODE=")).number(enable ? 1 : 0).end();
+	if ((err = wait(_submit(WIFI_CMD_GENERIC, Policy::timeOut, NULL))) == WIFI_ERR_OK) {
+		_passive = enable;
+		for (i = 0; i < ESP8266_RX_CHANNELS; i++)
+			_rx[i].pending = _rx[i].count;
+	}
+	return err;
+}
+/**
+ * Accumulate the length announced by +IPD in the passive mode.
+ * @parameter	channel	Connection ID
+ * @parameter	id		The announcement has the connection ID
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_announce(uint8_t channel, bool id) {
+	if (channel < ESP8266_RX_CHANNELS)
+		_rx[channel].pending += _ipdValue;
+	_passiveId = id;
+	_ipdPhase = WIFI_IPD_NONE;
+}
+/**
+ * Pull the data held by ESP8266 by AT+CIPRECVDATA.
+ * The reply "+CIPRECVDATA,<len>:<data>" is stored to the buffer
+ * directly without the receiving buffer of the connection.
+ * @parameter	channel	Connection ID, -1 for the single connection
+ * @parameter	buffer	Buffer to store the data
+ * @parameter	size	Length to be pulled
+ * @return		Stored data length
+ */
+template<class SerialT, class Policy>
+int16_t ESP8266Driver<SerialT, Policy>::_pull(int8_t channel, uint8_t *buffer, uint16_t size) {
+	_CmdLine<SerialT, Policy>	line(_uart);
+	WIFI_RXBUF	*rx = &_rx[channel < 0 ? 0 : channel];
+
+	if (size > ESP8266_PULL_MAX)
+		size = ESP8266_PULL_MAX;
+	// The reply carries the data, no other command can be interleaved.
+	if (!size || !_ready(true))
+		return 0;
+	_pullBuf = buffer;
+	_pullSize = size;
+	_pulled = 0;
+	line.text(F("AT+CIPRECVDATA="));
+	if (channel >= 0)
+		line.number(channel).put(',');
+	line.number(size).end();
+	(void)wait(_submit(WIFI_CMD_CIPRECVDATA, Policy::timeOut, NULL));
+	_pullBuf = NULL;
+	// The shorter reply means ESP8266 holds nothing any more.
+	rx->pending = _pulled < size || _pulled >= rx->pending ? 0 : rx->pending - _pulled;
+	return (int16_t)_pulled;
+}
+/**
+ * Take out the data from the receiving buffer.
+ * @parameter	rx		Receiving buffer
+ * @parameter	buffer	Destination, NULL to discard the data
+ * @parameter	size	Length to be taken out
+ * @return		Taken length
+ */
+template<class SerialT, class Policy>
+uint16_t ESP8266Driver<SerialT, Policy>::_take(WIFI_RXBUF *rx, uint8_t *buffer, uint16_t size) {
+	uint16_t	rlen = 0;
+	uint16_t	n;
+
+	// Copy out by the contiguous block up to the end of the buffer.
+	while (rx->count && rlen < size) {
+		n = ESP8266_RX_BUFF_SIZE - rx->head;
+		if (n > rx->count)
+			n = rx->count;
+		if (n > size - rlen)
+			n = size - rlen;
+		if (buffer)
+			memcpy(buffer + rlen, rx->buffer + rx->head, n);
+		rlen += n;
+		rx->head = (rx->head + n) % ESP8266_RX_BUFF_SIZE;
+		rx->count -= n;
+		rx->pending -= n;
+	}
+	_consume(rx, rlen);
+	return rlen;
+}
+/**
+ * Advance the frame boundaries by the taken length.
+ * The length beyond the arrived frames belongs to the frame
+ * being received.
+ * @parameter	rx		Receiving buffer
+ * @parameter	length	Taken length
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_consume(WIFI_RXBUF *rx, uint16_t length) {
+	uint16_t	n;
+
+	while (length && rx->frames) {
+		n = rx->frame[0].length < length ? rx->frame[0].length : length;
+		rx->frame[0].length -= n;
+		length -= n;
+		if (!rx->frame[0].length) {
+			rx->frames--;
+			memmove(&rx->frame[0], &rx->frame[1], rx->frames * sizeof(WIFI_FRAME));
+		}
+	}
+	if (length && _ipdPhase == WIFI_IPD_DATA && _ipdChannel < ESP8266_RX_CHANNELS && rx == &_rx[_ipdChannel])
+		_ipdFrame.length -= length < _ipdFrame.length ? length : _ipdFrame.length;
+}
+
+/**
+ * Find the connection which has the data to be read.
+ * @parameter	channel	connection ID, -1 for any connection
+ * @return		Connection ID which has the data, -1 for none
+ */
+template<class SerialT, class Policy>
+int8_t ESP8266Driver<SerialT, Policy>::_pending(int8_t channel) {
+	int8_t	rxCh;
+
+	if (channel >= ESP8266_RX_CHANNELS)
+		return -1;
+	if (channel >= 0)
+		return _rx[channel].pending ? channel : -1;
+	for (rxCh = 0; rxCh < ESP8266_RX_CHANNELS; rxCh++)
+		if (_rx[rxCh].pending)
+			return rxCh;
+	return -1;
+}
+
+/**
+ * Close the currently TCP/UPD active connection
+ * Execute to either CIPCLOSE or CIPSERVER=0, it is determined by
+ * the current connection type that is stored in <code>_conn</code>.
+ * When <code>WIFI_CONN_SERVER</code> then CIPSERVER=0,
+ * when <code>WIFI_CONN_CLIENT</code> then CIPCLOSE.
+ * @parameter	channel	the connection id to be closed
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::close(void) {
+	close(-1);
+}
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::close(int8_t channel) {
+	_idle();
+	(void)wait(closeAsync(channel));
+}
+/**
+ * Close the IP connection asynchronously.
+ * @parameter	channel		the connection id to be closed
+ * @parameter	callback	Completion notification, NULL if not needed
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::closeAsync(int8_t channel, WIFI_CALLBACK callback) {
+	WIFI_CMDSLOT	*slot;
+	WIFI_HANDLE	handle;
+	WIFI_CONN	conn = _conn;
+	_CmdLine<SerialT, Policy>	line(_uart);
+
+	if (!_ready())
+		return WIFI_HANDLE_NONE;
+	switch (conn) {
+	// Close the server connection
+	case WIFI_CONN_SERVER:
+		// The connection ID closes the client and the server remains.
+		if (channel >= 0)
+			line.text(F("AT+CIPCLOSE=")).number(channel).end();
+		else
+			line.text(F("AT+CIPSERVER=0")).end();
+		break;
+	// Close the client connection
+	case WIFI_CONN_CLIENT:
+	case WIFI_CONN_PEER:
+		line.text(F("AT+CIPCLOSE"));
+		if (channel >= 0)
+			line.put('=').number(channel);
+		line.end();
+		break;
+	case WIFI_CONN_NONE:
+		break;
+	}
+	// The other connections remain when the connection ID
+	// of the client is specified.
+	if (channel < 0) {
+		_conn = WIFI_CONN_NONE;
+#ifdef ESP8266_USE_POOL
+		memset(_pool, 0, sizeof(_pool));
+#endif
+	} else if (channel < ESP8266_RX_CHANNELS) {
+#ifdef ESP8266_USE_POOL
+		_pool[channel].state = WIFI_POOL_FREE;
+#endif
+		// CLOSED of the client is taken by the command.
+		if (_client[channel].connected) {
+			_client[channel].connected = false;
+			_client[channel].events |= WIFI_EVENT_CLOSE;
+		}
+	}
+	slot = _tail();
+	slot->channel = channel;
+	handle = _submit(WIFI_CMD_CIPCLOSE, Policy::timeOut, callback);
+	// Nothing to close, it concludes without the reply. The commands
+	// ahead are still waiting for their replies, then it concludes out
+	// of the order and is passed by them.
+	if (conn == WIFI_CONN_NONE) {
+		if (_cmdCount == 1)
+			_conclude(WIFI_ERR_OK);
+		else
+			_finish(slot, WIFI_ERR_OK);
+	}
+	return handle;
+}
+
+#ifdef ESP8266_USE_POOL
+/**
+ * Get the connection to the destination from the pool.
+ * The idle connection to the same destination is reused. Otherwise
+ * a free connection ID is connected, the least recently used idle
+ * connection is closed if no ID is free. It requires the multiple
+ * connection by WIFI_MUX_MULTI.
+ * @parameter	host		Destination host
+ * @parameter	port		Destination port
+ * @parameter	protocol	Connection protocol
+ * @return		Connection ID, -1 if not connected
+ */
+template<class SerialT, class Policy>
+int8_t ESP8266Driver<SerialT, Policy>::acquire(const char *host, uint16_t port, WIFI_PRO protocol) {
+	WIFI_POOLSLOT	*slot;
+	int8_t		channel, victim = -1;
+
+	// Reflect the arrived CLOSED notices.
+	_idle();
+	for (channel = 0; channel < ESP8266_RX_CHANNELS; channel++) {
+		slot = &_pool[channel];
+		if (slot->state == WIFI_POOL_IDLE && slot->port == port &&
+			slot->protocol == protocol && !strcmp(slot->host, host)) {
+			slot->state = WIFI_POOL_BUSY;
+			slot->usedAt = millis();
+			return channel;
+		}
+	}
+	// Find a free ID, or the least recently used idle connection.
+	for (channel = 0; channel < ESP8266_RX_CHANNELS; channel++) {
+		slot = &_pool[channel];
+		if (slot->state == WIFI_POOL_FREE) {
+			victim = channel;
+			break;
+		}
+		if (slot->state == WIFI_POOL_IDLE &&
+			(victim < 0 || millis() - slot->usedAt > millis() - _pool[victim].usedAt))
+			victim = channel;
+	}
+	if (victim < 0)
+		return -1;
+	slot = &_pool[victim];
+	if (slot->state == WIFI_POOL_IDLE) {
+		close(victim);
+		// The close which could not be issued keeps the connection.
+		if (slot->state != WIFI_POOL_FREE)
+			return -1;
+	}
+	// The ID stays free if the connect failed.
+	if (_connect(victim, protocol, (char *)host, port) != WIFI_ERR_CONNECT) {
+		slot->state = WIFI_POOL_FREE;
+		return -1;
+	}
+	// The host which does not fit is never matched.
+	if (strlen(host) < ESP8266_POOL_HOST_SIZE)
+		strcpy(slot->host, host);
+	else
+		slot->host[0] = '\0';
+	slot->port = port;
+	slot->protocol = protocol;
+	slot->state = WIFI_POOL_BUSY;
+	slot->usedAt = millis();
+	return victim;
+}
+
+/**
+ * Return the connection to the pool.
+ * The connection is kept alive for reuse by acquire. If the connection
+ * turned out to be broken, close it instead of the release.
+ * @parameter	channel	Connection ID which has been acquired
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::release(int8_t channel) {
+	if (channel < 0 || channel >= ESP8266_RX_CHANNELS || _pool[channel].state != WIFI_POOL_BUSY)
+		return;
+	// The connection which is not reusable is closed.
+	if (!_pool[channel].host[0])
+		close(channel);
+	else
+		_pool[channel].state = WIFI_POOL_IDLE;
+}
+#endif
+
+#ifdef ESP8266_USE_DNSCACHE
+/**
+ * Resolve the host name by ESP8266 and cache the address.
+ * The cached address is returned without the lookup while its TTL.
+ * @parameter	host	Host name
+ * @return		Resolved address, NULL if failed. The IP address
+ *				literal is returned as it is.
+ */
+template<class SerialT, class Policy>
+char *ESP8266Driver<SerialT, Policy>::resolve(const char *host) {
+	WIFI_DNSENTRY	*entry;
+
+	_idle();
+	if ((entry = _dnsLookup(host)) == NULL)
+		if ((entry = _resolve(host)) == NULL)
+			return ESP8266Detail::_literal(host) ? (char *)host : NULL;
+	entry->usedAt = millis();
+	return entry->ip;
+}
+
+/**
+ * Drop the cached address.
+ * @parameter	host	Host name, NULL for all hosts
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::invalidate(const char *host) {
+	WIFI_DNSENTRY	*entry;
+
+	if (!host)
+		memset(_dns, 0, sizeof(_dns));
+	else if ((entry = _dnsFind(host)) != NULL)
+		entry->host[0] = '\0';
+}
+
+/**
+ * Get the statistics of the resolution cache.
+ * @return		WIFI_DNSSTAT
+ */
+template<class SerialT, class Policy>
+WIFI_DNSSTAT ESP8266Driver<SerialT, Policy>::dnsStat(void) {
+	return _dnsStat;
+}
+
+/**
+ * Find the cached address of the host.
+ * The entry which exceeded TTL is dropped.
+ * @parameter	host	Host name
+ * @return		Cached entry, NULL if not cached
+ */
+template<class SerialT, class Policy>
+WIFI_DNSENTRY *ESP8266Driver<SerialT, Policy>::_dnsFind(const char *host) {
+	WIFI_DNSENTRY	*entry;
+	uint8_t		i;
+
+	for (i = 0; i < ESP8266_DNS_ENTRIES; i++) {
+		entry = &_dns[i];
+		if (!entry->host[0] || strcmp(entry->host, host))
+			continue;
+		if (millis() - entry->resolvedAt < ESP8266_DNS_TTL)
+			return entry;
+		entry->host[0] = '\0';
+	}
+	return NULL;
+}
+
+/**
+ * Find the cached address of the host with counting hit or miss.
+ * The IP address literal is not counted.
+ * @parameter	host	Host name
+ * @return		Cached entry, NULL if not cached
+ */
+template<class SerialT, class Policy>
+WIFI_DNSENTRY *ESP8266Driver<SerialT, Policy>::_dnsLookup(const char *host) {
+	WIFI_DNSENTRY	*entry;
+
+	if (ESP8266Detail::_literal(host))
+		return NULL;
+	if ((entry = _dnsFind(host)) != NULL)
+		_dnsStat.hits++;
+	else
+		_dnsStat.misses++;
+	return entry;
+}
+
+/**
+ * Resolve the host by AT+CIPDOMAIN and cache the address.
+ * The empty or the least recently used entry is replaced after the
+ * resolution succeeded, the failure keeps the cached ones.
+ * @parameter	host	Host name
+ * @return		Cached entry, NULL if failed or not cacheable
+ */
+template<class SerialT, class Policy>
+WIFI_DNSENTRY *ESP8266Driver<SerialT, Policy>::_resolve(const char *host) {
+	WIFI_DNSENTRY	*entry = &_dns[0];
+	char		ip[sizeof(entry->ip)];
+	uint8_t		i;
+
+	if (ESP8266Detail::_literal(host) || strlen(host) >= ESP8266_DNS_HOST_SIZE || !_ready())
+		return NULL;
+	ip[0] = '\0';
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPDOMAIN=")).quote(host).end();
+	_tail()->reply = ip;
+	if (wait(_submit(WIFI_CMD_CIPDOMAIN, 10000, NULL)) != WIFI_ERR_OK || !ip[0])
+		return NULL;
+	for (i = 0; i < ESP8266_DNS_ENTRIES; i++) {
+		if (!_dns[i].host[0]) {
+			entry = &_dns[i];
+			break;
+		}
+		if (millis() - _dns[i].usedAt > millis() - entry->usedAt)
+			entry = &_dns[i];
+	}
+	strcpy(entry->ip, ip);
+	strcpy(entry->host, host);
+	entry->resolvedAt = entry->usedAt = millis();
+	return entry;
+}
+#endif
+
+/**
+ * Enter the transparent transmission.
+ * It is available with the single connection that has been established.
+ * The received data is stored to the receiving buffer of the single
+ * connection as it is, read it by available and read. The AT commands
+ * are not accepted until endTransparent.
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::beginTransparent(void) {
+	WIFI_ERR	err;
+
+	_idle();
+	if (!_ready())
+		return WIFI_ERR_ERROR;
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPMODE=1")).end();
+	if ((err = wait(_submit(WIFI_CMD_CIPMODE, Policy::timeOut, NULL))) != WIFI_ERR_OK)
+		return err;
+	// CIPSEND without the length, the transmission starts at the prompt.
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPSEND")).end();
+	err = wait(_submit(WIFI_CMD_CIPSEND, Policy::timeOut, NULL, &_tail()->single, 0));
+	_txAt = millis();
+	return err;
+}
+
+/**
+ * Escape from the transparent transmission, and returns to the
+ * normal transmission mode. The connection is still kept.
+ * It takes ESP8266_ESCAPE_GUARD twice at least.
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::endTransparent(void) {
+	uint32_t	startAt;
+
+	if (!_transparent)
+		return WIFI_ERR_OK;
+	// +++ must be isolated from the preceding data.
+	while (millis() - _txAt < ESP8266_ESCAPE_GUARD)
+		(void)poll();
+	_CmdLine<SerialT, Policy>(_uart).text(F("+++")).flush();
+	// The data arrives until the escape would be effective.
+	startAt = millis();
+	while (millis() - startAt < ESP8266_ESCAPE_GUARD)
+		(void)poll();
+	_transparent = false;
+	_CmdLine<SerialT, Policy>(_uart).text(F("AT+CIPMODE=0")).end();
+	return wait(_submit(WIFI_CMD_CIPMODE, Policy::timeOut, NULL));
+}
+
+/**
+ * Write the data during the transparent transmission.
+ * @parameter	data	Sending data
+ * @parameter	length	Sending data length
+ * @return		Written length, 0 if not in the transparent transmission
+ */
+template<class SerialT, class Policy>
+uint16_t ESP8266Driver<SerialT, Policy>::write(const uint8_t *data, uint16_t length) {
+	if (!_transparent)
+		return 0;
+	ESP8266Detail::_clearToSend<Policy>();
+	length = _uart->write(data, length);
+	Policy::tap(WIFI_TAP_TX, WIFI_TAPLV_TRACE, data, length);
+	_txAt = millis();
+	ESP8266_Metric(_stats.sent += length);
+	return length;
+}
+template<class SerialT, class Policy>
+uint16_t ESP8266Driver<SerialT, Policy>::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+/**
+ * Set current baudrate of UART temporary.
+ * Baud rate of ESP8266 temporarily change the baudrate from 115200
+ * so as to be capable of processing even slow CPU. Baud rate would
+ * be returned to initial value by RST because it is changed by the
+ * +UART_CUR command temporarily.
+ * ESP8266 answers OK with the current rate and then changes it, so
+ * the serial port follows after the answer.
+ * The flow control is enabled along with the wired pins, 1 enables RTS
+ * of ESP8266 and 2 enables CTS of ESP8266.
+ * @parameter	baudrate	Baud rate to be set
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::setBaudrate(uint32_t baudrate) {
+	WIFI_ERR	err;
+	uint8_t		flow = (Policy::ctsPin >= 0 ? 1 : 0) | (Policy::rtsPin >= 0 ? 2 : 0);
+
+	_CmdLine<SerialT, Policy>(_uart).text(F(ESP8266_AT_UART "=")).number(baudrate).text(F(",8,1,0,")).number(flow).end();
+	err = wait(_submit(WIFI_CMD_GENERIC, Policy::timeOut, NULL));
+	_switch(baudrate);
+	return err;
+}
+
+/**
+ * Change the baud rate of the serial port.
+ * The received data at the previous rate is discarded.
+ * @parameter	baudrate	Baud rate to be set
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_switch(uint32_t baudrate) {
+	_uart->flush();
+	_uart->end();
+	_uart->begin(baudrate);
+	while (_uart->read() >= 0)
+		ESP8266_Metric(_stats.flushed++);
+	_findState = 0;
+	_lineLen = 0;
+}
+
+/**
+ * Run the echo tests at the specified baud rate.
+ * @parameter	baudrate	Baud rate to be tested
+ * @parameter	count		Number of the tests
+ * @return		Number of the passed tests
+ */
+template<class SerialT, class Policy>
+uint8_t ESP8266Driver<SerialT, Policy>::_probe(uint32_t baudrate, uint8_t count) {
+	uint8_t	passed = 0;
+
+	_switch(baudrate);
+	while (count--) {
+		_link.probes++;
+		_CmdLine<SerialT, Policy>(_uart).text(F("AT")).end();
+		if (wait(_submit(WIFI_CMD_GENERIC, ESP8266_BAUD_TIMEOUT, NULL)) == WIFI_ERR_OK)
+			passed++;
+		else
+			_link.errors++;
+	}
+	return passed;
+}
+
+/**
+ * Raise the baud rate and verify it.
+ * If the verification fails, ESP8266 is returned to the previous rate.
+ * @parameter	baudrate	Baud rate to be raised
+ * @return		true	The raised rate is adopted
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_shift(uint32_t baudrate) {
+	uint32_t	previous = _baudrate;
+	uint8_t		retry;
+
+	if (setBaudrate(baudrate) != WIFI_ERR_OK) {
+		// The request itself failed, ESP8266 is still at the previous rate.
+		_switch(previous);
+		_link.rejects++;
+		return false;
+	}
+	if (_probe(baudrate, ESP8266_BAUD_PROBES) == ESP8266_BAUD_PROBES) {
+		_baudrate = baudrate;
+		return true;
+	}
+	// The link does not hold up, go back through the unstable link.
+	_link.rejects++;
+	for (retry = 0; retry < 3; retry++)
+		if (setBaudrate(previous) == WIFI_ERR_OK)
+			break;
+	_switch(previous);
+	return false;
+}
+
+namespace ESP8266Detail {
+
+// Terms to detect the discernable response from ESP8266 AT.
+// The dispatcher finds these terms from the receiving stream
+// with a single state machine instead of walking each term per a byte.
+// Each term has a return condition at the same position. A character
+// used in the term must also be listed in the charset, the automaton
+// is built over these characters only.
+// The specification is a class so that the arrays have the linkage
+// of their own, they are evaluated only by the compiler and have no
+// definition in the library.
+struct _FindSpec {
+	static constexpr const char	*term[] = {
+		"CONNECT\r\n",
+		"SEND OK\r\n",
+		"SEND FAIL",
+		"CLOSED",
+		"busy",
+		"\nERROR",
+		"\nOK\r\n",
+		"\nFAIL",
+		"\n>",
+		"+IPD,",
+		"+CIPRECVDATA,"
+	};
+	static constexpr int8_t	condition[] = {
+		WIFI_ERR_CONNECT,
+		WIFI_ERR_SENDOK,
+		WIFI_ERR_SENDFAIL,
+		WIFI_ERR_CLOSED,
+		WIFI_ERR_BUSY,
+		WIFI_ERR_ERROR,
+		WIFI_ERR_OK,
+		WIFI_ERR_ERROR,
+		WIFI_ERR_PROMPT,
+		WIFI_ERR_IPD,
+		WIFI_ERR_IPD
+	};
+	static constexpr char	charset[] = "\n\r +,>ABCDEFIKLNOPRSTUVbsuy";
+};
+
+// Compile-time construction of the Aho-Corasick automaton.
+// A state is the matched length of a term, it is numbered along the
+// terms sequence with 0 as the initial state. Each state keeps only
+// the edges of its own terms and the failure link, which is followed
+// for the character without the edge. The failure links are taken
+// fewer times than the edges in total, so the matching stays linear
+// while the tables take a few hundred bytes instead of the dense
+// transitions of every state and character.
+// All of the following are evaluated by the compiler, and only the
+// resulting tables are emitted to the program memory.
+constexpr uint8_t	_FIND_TERMS = sizeof(_FindSpec::term) / sizeof(_FindSpec::term[0]);
+constexpr uint8_t	_FIND_CHARS = sizeof(_FindSpec::charset) - 1;
+
+constexpr uint8_t _findLen(const char *s) {
+	return *s ? _findLen(s + 1) + 1 : 0;
+}
+constexpr uint8_t _findBase(uint8_t t) {
+	return t ? _findBase(t - 1) + _findLen(_FindSpec::term[t - 1]) : 0;
+}
+constexpr bool _findKnown(char c, uint8_t k = 0) {
+	return k < _FIND_CHARS && (_FindSpec::charset[k] == c || _findKnown(c, k + 1));
+}
+constexpr bool _findCovered(uint8_t t = 0, uint8_t i = 0) {
+	return t == _FIND_TERMS ? true : !_FindSpec::term[t][i] ? _findCovered(t + 1) : _findKnown(_FindSpec::term[t][i]) && _findCovered(t, i + 1);
+}
+constexpr uint8_t	_FIND_STATES = _findBase(_FIND_TERMS) + 1;
+static_assert(sizeof(_FindSpec::condition) == _FIND_TERMS, "The conditions do not correspond to the terms");
+static_assert(_findCovered(), "The charset lacks a character used in the terms");
+static_assert(_FIND_STATES < 0xff, "Too many states of the terms");
+
+// Term index and matched length of each state
+constexpr uint8_t _findTerm(uint8_t s, uint8_t t = 0) {
+	return t + 1 < _FIND_TERMS && s > _findBase(t + 1) ? _findTerm(s, t + 1) : t;
+}
+constexpr uint8_t _findDepth(uint8_t s) {
+	return s ? s - _findBase(_findTerm(s)) : 0;
+}
+
+// Index sequence generator to expand the tables.
+template<unsigned... I> struct _Seq { typedef _Seq type; };
+template<class A, class B> struct _SeqCat;
+template<unsigned... A, unsigned... B> struct _SeqCat<_Seq<A...>, _Seq<B...> > : _Seq<A..., (sizeof...(A) + B)...> {};
+template<unsigned N> struct _SeqOf : _SeqCat<typename _SeqOf<N / 2>::type, typename _SeqOf<N - N / 2>::type> {};
+template<> struct _SeqOf<0> : _Seq<> {};
+template<> struct _SeqOf<1> : _Seq<0> {};
+
+template<class S> struct _FindState;
+template<unsigned... I> struct _FindState<_Seq<I...> > {
+	static constexpr uint8_t	term[sizeof...(I)] = { _findTerm(I)... };
+	static constexpr uint8_t	depth[sizeof...(I)] = { _findDepth(I)... };
+};
+template<unsigned... I> constexpr uint8_t _FindState<_Seq<I...> >::term[sizeof...(I)];
+template<unsigned... I> constexpr uint8_t _FindState<_Seq<I...> >::depth[sizeof...(I)];
+typedef _FindState<_SeqOf<_FIND_STATES>::type>	_FIND_STATE;
+
+// Transition functions of the automaton.
+constexpr bool _findSame(uint8_t t, uint8_t u, uint8_t n) {
+	return !n || (_FindSpec::term[t][n - 1] == _FindSpec::term[u][n - 1] && _findSame(t, u, n - 1));
+}
+constexpr uint8_t _findGoto(uint8_t s, char c, uint8_t u = 0) {
+	return u == _FIND_TERMS ? 0xff
+		: _findLen(_FindSpec::term[u]) > _FIND_STATE::depth[s]
+		  && _FindSpec::term[u][_FIND_STATE::depth[s]] == c
+		  && _findSame(_FIND_STATE::term[s], u, _FIND_STATE::depth[s]) ? _findBase(u) + _FIND_STATE::depth[s] + 1
+		: _findGoto(s, c, u + 1);
+}
+constexpr uint8_t _findFail(uint8_t s);
+constexpr uint8_t _findNext(uint8_t s, char c) {
+	return _findGoto(s, c) != 0xff ? _findGoto(s, c) : s ? _findNext(_findFail(s), c) : 0;
+}
+constexpr uint8_t _findFail(uint8_t s) {
+	return _FIND_STATE::depth[s] <= 1 ? 0 : _findNext(_findFail(s - 1), _FindSpec::term[_FIND_STATE::term[s]][_FIND_STATE::depth[s] - 1]);
+}
+constexpr uint8_t _findAccept(uint8_t s) {
+	return !s ? 0 : _FIND_STATE::depth[s] == _findLen(_FindSpec::term[_FIND_STATE::term[s]]) ? _FIND_STATE::term[s] + 1 : _findAccept(_findFail(s));
+}
+
+// Edges of the automaton. The state of a term whose prefix is shared
+// with the preceding term is never reached, so it has no edge.
+constexpr bool _findFirst(uint8_t t, uint8_t n, uint8_t u = 0) {
+	return u == t || (!(_findLen(_FindSpec::term[u]) >= n && _findSame(t, u, n)) && _findFirst(t, n, u + 1));
+}
+constexpr bool _findLive(uint8_t s) {
+	return !s || _findFirst(_FIND_STATE::term[s], _FIND_STATE::depth[s]);
+}
+constexpr bool _findEdge(uint8_t s, uint8_t k) {
+	return _findLive(s) && _findGoto(s, _FindSpec::charset[k]) != 0xff;
+}
+constexpr uint8_t _findEdges(uint8_t s, uint8_t k = 0) {
+	return k == _FIND_CHARS ? 0 : _findEdge(s, k) + _findEdges(s, k + 1);
+}
+constexpr uint8_t _findEdgeAt(uint8_t s) {
+	return s ? _findEdgeAt(s - 1) + _findEdges(s - 1) : 0;
+}
+constexpr uint8_t _findOwner(uint8_t i, uint8_t s = 0) {
+	return _findEdgeAt(s + 1) > i ? s : _findOwner(i, s + 1);
+}
+constexpr char _findChar(uint8_t s, uint8_t n, uint8_t k = 0) {
+	return !_findEdge(s, k) ? _findChar(s, n, k + 1) : n ? _findChar(s, n - 1, k + 1) : _FindSpec::charset[k];
+}
+constexpr char _findEdgeChar(uint8_t i) {
+	return _findChar(_findOwner(i), i - _findEdgeAt(_findOwner(i)));
+}
+static_assert(_findEdgeAt(_FIND_STATES) < 0xff, "Too many edges of the terms");
+
+// Table generators, each entry is forced to be a constant through _FindByte.
+template<uint8_t V> struct _FindByte { enum { v = V }; };
+struct _FindAtGen {
+	static constexpr uint8_t at(unsigned i) { return _findEdgeAt(i); }
+};
+struct _FindCharGen {
+	static constexpr uint8_t at(unsigned i) { return (uint8_t)_findEdgeChar(i); }
+};
+struct _FindGotoGen {
+	static constexpr uint8_t at(unsigned i) { return _findGoto(_findOwner(i), _findEdgeChar(i)); }
+};
+struct _FindFailGen {
+	static constexpr uint8_t at(unsigned i) { return _findFail(i); }
+};
+struct _FindAcceptGen {
+	static constexpr uint8_t at(unsigned i) { return _findAccept(i); }
+};
+struct _FindConditionGen {
+	static constexpr uint8_t at(unsigned i) { return (uint8_t)_FindSpec::condition[i]; }
+};
+template<class G, class S> struct _FindTable;
+template<class G, unsigned... I> struct _FindTable<G, _Seq<I...> > {
+	static const uint8_t	v[sizeof...(I)];
+};
+template<class G, unsigned... I> const uint8_t _FindTable<G, _Seq<I...> >::v[sizeof...(I)] PROGMEM = { _FindByte<G::at(I)>::v... };
+
+// First edge of each state, the last entry is the number of the edges
+typedef _FindTable<_FindAtGen, _SeqOf<_FIND_STATES + 1>::type>	_FIND_EDGE_AT;
+// Character and the destination state of each edge
+typedef _FindTable<_FindCharGen, _SeqOf<_findEdgeAt(_FIND_STATES)>::type>	_FIND_EDGE_CHAR;
+typedef _FindTable<_FindGotoGen, _SeqOf<_findEdgeAt(_FIND_STATES)>::type>	_FIND_EDGE_GOTO;
+// Failure link of each state
+typedef _FindTable<_FindFailGen, _SeqOf<_FIND_STATES>::type>	_FIND_FAIL;
+// Detected term number plus 1 for each state, 0 is not detected
+typedef _FindTable<_FindAcceptGen, _SeqOf<_FIND_STATES>::type>	_FIND_ACCEPT;
+// Return condition of each term
+typedef _FindTable<_FindConditionGen, _SeqOf<_FIND_TERMS>::type>	_FIND_CONDITION;
+
+/**
+ * Advance the matching state by a received character.
+ * @parameter	state	Matching state to be advanced
+ * @parameter	c		Received character
+ * @return		Condition of the detected term,
+ *				<code>WIFI_ERR_TIMEOUT</code> if not detected yet
+ */
+inline WIFI_ERR _findStep(uint8_t &state, uint8_t c) {
+	uint8_t	i, end, accept;
+
+	for (;;) {
+		end = pgm_read_byte(&_FIND_EDGE_AT::v[state + 1]);
+		for (i = pgm_read_byte(&_FIND_EDGE_AT::v[state]); i < end; i++)
+			if (pgm_read_byte(&_FIND_EDGE_CHAR::v[i]) == c)
+				break;
+		if (i < end) {
+			state = pgm_read_byte(&_FIND_EDGE_GOTO::v[i]);
+			break;
+		}
+		if (!state)
+			break;
+		state = pgm_read_byte(&_FIND_FAIL::v[state]);
+	}
+	if ((accept = pgm_read_byte(&_FIND_ACCEPT::v[state])) != 0)
+		return (WIFI_ERR)(int8_t)pgm_read_byte(&_FIND_CONDITION::v[accept - 1]);
+	return WIFI_ERR_TIMEOUT;
+}
+
+/**
+ * Inquire whether the line consists of the connection ID and the term,
+ * as "<id>,CONNECT" in the multiple connection or "CONNECT" alone.
+ * @parameter	line	Line being framed, it is not terminated
+ * @parameter	length	Length of the line
+ * @parameter	term	Term in PROGMEM
+ * @parameter	channel	Connection ID, -1 for the line without the ID
+ * @return		true	The line is the term of the connection ID
+ */
+inline bool _linkTerm(const char *line, uint8_t length, PGM_P term, int8_t channel) {
+	uint8_t	prefix = channel < 0 ? 0 : 2;
+
+	if (length != prefix + strlen_P(term))
+		return false;
+	if (prefix && (line[0] != '0' + channel || line[1] != ','))
+		return false;
+	return !strncmp_P(line + prefix, term, length - prefix);
+}
+
+/**
+ * Find the quoted value which follows the prefix in the line.
+ * @parameter	line	Response line
+ * @parameter	prefix	Prefix up to the opening quote in PROGMEM
+ * @return		Head of the value, NULL if the prefix does not match
+ */
+inline const char *_quoted(const char *line, PGM_P prefix) {
+	size_t	len = strlen_P(prefix);
+
+	return strncmp_P(line, prefix, len) ? NULL : line + len;
+}
+
+/**
+ * Copy the quoted value up to the closing quote.
+ * @parameter	dest	Buffer to store the value
+ * @parameter	sp		Head of the value
+ * @parameter	size	Buffer size
+ */
+inline void _unquote(char *dest, const char *sp, uint8_t size) {
+	while (*sp && *sp != '"' && --size)
+		*dest++ = *sp++;
+	*dest = '\0';
+}
+
+/**
+ * Parse an entry of +CWLAP and keep it if it is stronger than the
+ * weakest one kept. The line is "<ecn>,"<ssid>",<rssi>,<channel>)" by
+ * AT+CWLAPOPT, or "<ecn>,"<ssid>",<rssi>,"<mac>",<channel>,...)".
+ * @parameter	scan	Scan in progress
+ * @parameter	sp		Line following "+CWLAP:("
+ */
+inline void _scanEntry(WIFI_SCAN *scan, const char *sp) {
+	const WIFI_SCANFILTER	*filter = scan->filter;
+	WIFI_AP		ap;
+
+	ap.ecn = (uint8_t)atoi(sp);
+	if ((sp = strchr(sp, '"')) == NULL)
+		return;
+	_unquote(ap.ssid, ++sp, sizeof(ap.ssid));
+	sp += strlen(ap.ssid);
+	if (*sp++ != '"' || *sp++ != ',')
+		return;
+	ap.rssi = (int8_t)atoi(sp);
+	ap.channel = 0;
+	if ((sp = strchr(sp, ',')) != NULL) {
+		// Skip <mac> which AT+CWLAPOPT did not trim.
+		if (*++sp == '"' && (sp = strchr(sp + 1, '"')) != NULL && *++sp == ',')
+			sp++;
+		if (sp && *sp >= '0' && *sp <= '9')
+			ap.channel = (uint8_t)atoi(sp);
+	}
+	scan->seen++;
+	if (filter && ((filter->ssid && strcmp(filter->ssid, ap.ssid))
+		|| (filter->ecnMask && !(filter->ecnMask & (1 << ap.ecn)))
+		|| (filter->channel && filter->channel != ap.channel)
+		|| (filter->minRssi && ap.rssi < filter->minRssi)))
+		return;
+	if (scan->count < scan->capacity) {
+		scan->list[scan->count] = ap;
+		_heapUp(scan->list, scan->count++);
+	} else if (scan->count && ap.rssi > scan->list[0].rssi) {
+		scan->list[0] = ap;
+		_heapDown(scan->list, scan->count, 0);
+	}
+}
+
+}	// namespace ESP8266Detail
+
+/**
+ * Advance the asynchronous commands in progress.
+ * It reads the arrived data as much as available, sorts the received
+ * data to each connection and drives the commands by the detected
+ * terms. The completion callback is invoked from here when the
+ * command concludes.
+ * @return		true	The command is still in progress
+ *				false	No command in progress
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::poll(void) {
+	_pump();
+	if (_progress() && millis() - _cmd[_cmdHead].startAt >= _cmd[_cmdHead].timeOut)
+		_conclude(WIFI_ERR_TIMEOUT);
+	return _progress();
+}
+
+/**
+ * Read out the arrived data from ESP8266 and dispatch it.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_pump(void) {
+	uint8_t		batch[ESP8266_RX_BATCH];
+	int			n;
+	uint8_t		i, m;
+	bool		got = false;
+	bool		lost;
+
+	// The arrived bytes are taken out without waiting, and the batch
+	// is passed to the debug tap and the dispatcher at once.
+	while ((n = _uart->available()) > 0) {
+		// ESP8266 is paused while the serial buffer is filling up.
+		if (Policy::rxSize && (uint16_t)n >= Policy::rxSize * 3 / 4)
+			_flow(true);
+		// The bytes overflowed from the full buffer are lost after the
+		// buffered ones, the frame across the gap is invalidated.
+		lost = Policy::overrun(*_uart);
+		while (n > 0) {
+			m = n > ESP8266_RX_BATCH ? ESP8266_RX_BATCH : (uint8_t)n;
+			for (i = 0; i < m; i++)
+				batch[i] = (uint8_t)_uart->read();
+			Policy::tap(WIFI_TAP_RX, WIFI_TAPLV_TRACE, batch, m);
+			_dispatch(batch, m);
+			n -= m;
+		}
+		if (lost)
+			_invalidate();
+		got = true;
+	}
+	// The pause holds until the buffers are drained enough, so that
+	// RTS does not chatter around the threshold.
+	if (!_paused)
+		_flow(_congested(ESP8266_RX_PAUSE));
+	else if (!_congested(ESP8266_RX_RESUME))
+		_flow(false);
+	// The debug tap is drained while the line is quiet.
+	if (!got)
+		Policy::idle();
+}
+
+/**
+ * Pause or resume ESP8266 by RTS.
+ * The pause is counted at the transition.
+ * @parameter	pause	true to pause
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_flow(bool pause) {
+	if (Policy::rtsPin < 0 || pause == _paused)
+		return;
+	digitalWrite(Policy::rtsPin, pause ? HIGH : LOW);
+	_paused = pause;
+	if (pause)
+		_uartStat.pauses++;
+}
+
+/**
+ * Inquire whether a connection buffer is too full to receive more.
+ * The asynchronous command in progress is paused along with the data,
+ * the sketch which polls it drains the buffers. While the sketch is
+ * blocked for the reply, nothing drains them, so ESP8266 is not paused
+ * and the reply goes on to the line buffer.
+ * @parameter	level	Stored bytes of a connection to be congested
+ * @return		true	ESP8266 should be paused
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_congested(uint8_t level) {
+	uint8_t		i;
+
+	if (Policy::rtsPin < 0 || _waiting)
+		return false;
+	for (i = 0; i < ESP8266_RX_CHANNELS; i++)
+		if (_rx[i].count >= level)
+			return true;
+	return false;
+}
+
+/**
+ * Invalidate the frame broken by the overrun.
+ * The stored part of the payload is withdrawn from the connection and
+ * the rest is resynchronized by the term matching from the next line.
+ * The broken header is abandoned as well.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_invalidate(void) {
+	WIFI_RXBUF	*rx;
+
+	_uartStat.overruns++;
+	// The line and the term across the gap are broken in any phase.
+	_findState = 0;
+	_lineLen = 0;
+	_lineTaken = false;
+	if (_ipdPhase == WIFI_IPD_NONE || _transparent)
+		return;
+	if (_ipdPhase == WIFI_IPD_DATA && _ipdChannel < ESP8266_RX_CHANNELS) {
+		rx = &_rx[_ipdChannel];
+		rx->count -= (uint8_t)_ipdFrame.length;
+		rx->pending -= _ipdFrame.length + _ipdRemain;
+	}
+	_ipdPhase = WIFI_IPD_NONE;
+	_uartStat.invalidated++;
+}
+
+/**
+ * Dispatch the received data.
+ * The payload of +IPD is stored to the receiving buffer of the
+ * connection as a block without the term matching, so that the data
+ * never be confused with the response. The others are driven to the
+ * command by each character.
+ * @parameter	data	Received data
+ * @parameter	length	Length of the data
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_dispatch(const uint8_t *data, uint8_t length) {
+	WIFI_RXBUF	*rx;
+	uint8_t		n, stored;
+	PGM_P		mark;
+
+	while (length) {
+		// All received data belongs to the single connection during
+		// the transparent transmission.
+		if (_transparent) {
+			stored = _store(&_rx[0], data, length);
+			_rx[0].pending += stored;
+			ESP8266_Metric(_stats.received += stored);
+			ESP8266_Metric(_stats.dropped += length - stored);
+			return;
+		}
+		if (_ipdPhase != WIFI_IPD_DATA) {
+			_dispatch(*data++);
+			length--;
+			continue;
+		}
+		// Store the data to the ring buffer of the connection,
+		// it would be discarded when the buffer is full.
+		n = _ipdRemain < length ? (uint8_t)_ipdRemain : length;
+		// The payload which ran over the lost bytes takes in the next
+		// output. The frame is invalidated, and the output is parsed
+		// again from its beginning.
+		if ((stored = _overran(data, n)) != 0) {
+			mark = _ipdMark == sizeof(ESP8266Detail::_IPD_MARK) - 1 ? ESP8266Detail::_IPD_MARK : ESP8266Detail::_OK_MARK;
+			_invalidate();
+			while (pgm_read_byte(mark))
+				_dispatch((uint8_t)pgm_read_byte(mark++));
+			data += stored;
+			length -= stored;
+			continue;
+		}
+		stored = 0;
+		if (_ipdChannel == ESP8266Detail::_PULL_CHANNEL) {
+			// The pulled data is stored to the buffer of receive directly.
+			if (_pullBuf) {
+				stored = _pullSize - _pulled < n ? (uint8_t)(_pullSize - _pulled) : n;
+				memcpy(_pullBuf + _pulled, data, stored);
+				_pulled += stored;
+			}
+		} else if (_ipdChannel < ESP8266_RX_CHANNELS) {
+			rx = &_rx[_ipdChannel];
+			stored = _store(rx, data, n);
+			rx->pending -= n - stored;
+			_ipdFrame.length += stored;
+		}
+		ESP8266_Metric(_stats.received += stored);
+		ESP8266_Metric(_stats.dropped += n - stored);
+		// The payload which ran over the lost bytes is followed by
+		// the binary data instead of the next line.
+		if ((_ipdRemain -= n) == 0) {
+			if (length > n && !ESP8266Detail::_textual(data[n]))
+				_invalidate();
+			else
+				_ipdEnd();
+		}
+		data += n;
+		length -= n;
+	}
+}
+
+/**
+ * Store the data to the ring buffer by the contiguous block.
+ * @parameter	rx		Receiving buffer
+ * @parameter	data	Data to be stored
+ * @parameter	length	Length of the data
+ * @return		Stored length, the rest overflowed
+ */
+template<class SerialT, class Policy>
+uint8_t ESP8266Driver<SerialT, Policy>::_store(WIFI_RXBUF *rx, const uint8_t *data, uint8_t length) {
+	uint8_t		stored = 0;
+	uint8_t		tail, n;
+
+	while (length && rx->count < ESP8266_RX_BUFF_SIZE) {
+		tail = (rx->head + rx->count) % ESP8266_RX_BUFF_SIZE;
+		// The free space continues up to the end of the buffer or the head.
+		n = tail >= rx->head ? ESP8266_RX_BUFF_SIZE - tail : rx->head - tail;
+		if (n > length)
+			n = length;
+		memcpy(rx->buffer + tail, data, n);
+		rx->count += n;
+		data += n;
+		length -= n;
+		stored += n;
+	}
+	return stored;
+}
+
+/**
+ * Find the output which the payload ran over the lost bytes took in.
+ * The data is skipped up to CR while nothing is matching, so that the
+ * payload is not matched by each character.
+ * @parameter	data	Part of the payload
+ * @parameter	length	Length of the part
+ * @return		Length up to the end of the output, 0 if not found
+ */
+template<class SerialT, class Policy>
+uint8_t ESP8266Driver<SerialT, Policy>::_overran(const uint8_t *data, uint8_t length) {
+	const uint8_t	*p = data;
+	const uint8_t	*end = data + length;
+
+	while (p < end) {
+		if (!_ipdMark && !_okMark && (p = (const uint8_t *)memchr(p, '\r', end - p)) == NULL)
+			return 0;
+		_ipdMark = ESP8266Detail::_markStep(_ipdMark, ESP8266Detail::_IPD_MARK, *p);
+		_okMark = ESP8266Detail::_markStep(_okMark, ESP8266Detail::_OK_MARK, *p++);
+		if (_ipdMark == sizeof(ESP8266Detail::_IPD_MARK) - 1 || _okMark == sizeof(ESP8266Detail::_OK_MARK) - 1)
+			return (uint8_t)(p - data);
+	}
+	return 0;
+}
+
+/**
+ * Start the payload of +IPD after the header.
+ * The empty or broken frame is ignored.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_ipdBegin(void) {
+	if (!_ipdRemain) {
+		_ipdPhase = WIFI_IPD_NONE;
+		return;
+	}
+	if (_ipdChannel < ESP8266_RX_CHANNELS)
+		_rx[_ipdChannel].pending += _ipdRemain;
+	_ipdLength = _ipdRemain;
+	_ipdFrame.length = 0;
+	_ipdMark = 0;
+	_okMark = 0;
+	_ipdPhase = WIFI_IPD_DATA;
+	ESP8266_Metric(_stats.frames++);
+}
+/**
+ * Conclude the payload of +IPD and record its boundary.
+ * The frame beyond ESP8266_RX_FRAMES is merged into the last one on
+ * the stream. The datagram never be merged to keep its remote end,
+ * it is taken back from the tail of the buffer and discarded.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_ipdEnd(void) {
+	WIFI_RXBUF	*rx;
+	WIFI_FRAME	*last;
+	uint8_t		n;
+
+	_ipdPhase = WIFI_IPD_NONE;
+	if (_ipdChannel >= ESP8266_RX_CHANNELS || !_ipdFrame.length)
+		return;
+	rx = &_rx[_ipdChannel];
+	if (rx->frames < ESP8266_RX_FRAMES) {
+		rx->frame[rx->frames++] = _ipdFrame;
+		if (rx->datagram && _ipdFrame.length < _ipdLength)
+			ESP8266_Metric(_stats.truncated++);
+	} else if (rx->datagram) {
+		n = _ipdFrame.length < rx->count ? (uint8_t)_ipdFrame.length : rx->count;
+		rx->count -= n;
+		rx->pending -= n;
+		ESP8266_Metric(_stats.received -= n);
+		ESP8266_Metric(_stats.dropped += n);
+		ESP8266_Metric(_stats.discarded++);
+	} else {
+		last = &rx->frame[rx->frames - 1];
+		_ipdFrame.length += last->length;
+		*last = _ipdFrame;
+	}
+}
+
+/**
+ * Dispatch a received character out of the payload.
+ * @parameter	c	Received character
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_dispatch(uint8_t c) {
+	WIFI_ERR	condition;
+
+	switch (_ipdPhase) {
+	case WIFI_IPD_FIRST:
+	case WIFI_IPD_LENGTH:
+	case WIFI_IPD_ADDR:
+	case WIFI_IPD_PORT:
+		// Parse "+IPD,[<id>,]<len>[,<ip>,<port>]:", the remote end
+		// follows with AT+CIPDINFO=1.
+		if (c >= '0' && c <= '9') {
+			_ipdValue = _ipdValue * 10 + (c - '0');
+			break;
+		}
+		switch (_ipdPhase) {
+		case WIFI_IPD_FIRST:
+			if (c == ',') {
+				// Connection ID, or the length of the single connection
+				_ipdChannel = (uint8_t)_ipdValue;
+				_ipdPhase = WIFI_IPD_LENGTH;
+			} else if (c == ':') {
+				// It is the reply of AT+CIPRECVDATA in the passive mode.
+				_ipdChannel = _passive ? ESP8266Detail::_PULL_CHANNEL : 0;
+				_ipdRemain = _ipdValue;
+				_ipdBegin();
+			} else if (c == '\r' && _passive)
+				_announce(0, false);
+			else {
+				// The malformed header is abandoned.
+				_ipdPhase = WIFI_IPD_NONE;
+				_uartStat.framing++;
+			}
+			break;
+		case WIFI_IPD_LENGTH:
+			if (c == ',' || c == ':') {
+				_ipdRemain = _ipdValue;
+				_ipdPhase = WIFI_IPD_ADDR;
+				if (c == ':')
+					_ipdBegin();
+			} else if (c == '.') {
+				// The address of the single connection has started.
+				_ipdRemain = _ipdChannel;
+				_ipdChannel = 0;
+				_ipdFrame.ip[_ipdOctet++] = (uint8_t)_ipdValue;
+				_ipdPhase = WIFI_IPD_ADDR;
+			} else if (c == '\r' && _passive)
+				_announce(_ipdChannel, true);
+			else {
+				_ipdPhase = WIFI_IPD_NONE;
+				_uartStat.framing++;
+			}
+			break;
+		case WIFI_IPD_ADDR:
+			if (c == '.' && _ipdOctet < 3)
+				_ipdFrame.ip[_ipdOctet++] = (uint8_t)_ipdValue;
+			else if (c == ',' && _ipdOctet == 3) {
+				_ipdFrame.ip[_ipdOctet] = (uint8_t)_ipdValue;
+				_ipdPhase = WIFI_IPD_PORT;
+			} else {
+				_ipdPhase = WIFI_IPD_NONE;
+				_uartStat.framing++;
+			}
+			break;
+		default:
+			if (c == ':') {
+				_ipdFrame.port = _ipdValue;
+				_ipdBegin();
+			} else {
+				_ipdPhase = WIFI_IPD_NONE;
+				_uartStat.framing++;
+			}
+			break;
+		}
+		_ipdValue = 0;
+		break;
+	case WIFI_IPD_NONE:
+		if ((condition = ESP8266Detail::_findStep(_findState, c)) == WIFI_ERR_IPD) {
+			_ipdPhase = WIFI_IPD_FIRST;
+			_ipdRemain = 0;
+			_ipdValue = 0;
+			_ipdOctet = 0;
+			memset(&_ipdFrame, 0, sizeof(_ipdFrame));
+			_findState = 0;
+			// +IPD is not a line.
+			_lineLen = 0;
+			break;
+		}
+		if (condition != WIFI_ERR_TIMEOUT && _progress())
+			(void)_advance(condition);
+		// The prompt is not terminated by the newline.
+		if (condition == WIFI_ERR_PROMPT) {
+			_lineLen = 0;
+			_lineTaken = false;
+		} else
+			_frame(c);
+		break;
+	case WIFI_IPD_DATA:
+		// The payload is stored by the block.
+		break;
+	}
+}
+
+/**
+ * Frame the response by the line.
+ * The completed line is taken by the command in progress, or handed
+ * to the notice handler if unsolicited. The empty line is ignored.
+ * @parameter	c	Received character
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_frame(uint8_t c) {
+	if (c == '\n') {
+		_line[_lineLen] = '\0';
+		if (_lineLen && !_lineTaken)
+			if (!_progress() || !_collect(&_cmd[_cmdHead], _line))
+				_notice(_line);
+		_lineLen = 0;
+		_lineTaken = false;
+	} else if (c != '\r' && _lineLen < ESP8266_LINE_SIZE - 1)
+		_line[_lineLen++] = (char)c;
+}
+
+/**
+ * Take the information line by the command in progress.
+ * @parameter	slot	Command in progress
+ * @parameter	line	Response line
+ * @return		true	The line has been taken
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_collect(WIFI_CMDSLOT *slot, const char *line) {
+	const char	*sp;
+
+	switch (slot->cmd) {
+	case WIFI_CMD_RST:
+		// All the boot messages are taken.
+		if (!strcmp_P(line, PSTR("ready")))
+			_conclude(WIFI_ERR_OK);
+		return true;
+	case WIFI_CMD_CIFSR:
+		if ((sp = ESP8266Detail::_quoted(line, PSTR("+CIFSR:STAIP,\""))) != NULL)
+			ESP8266Detail::_unquote(_ipAddrSta, sp, sizeof(_ipAddrSta));
+		else if ((sp = ESP8266Detail::_quoted(line, PSTR("+CIFSR:APIP,\""))) != NULL)
+			ESP8266Detail::_unquote(_ipAddrAp, sp, sizeof(_ipAddrAp));
+		else if (strncmp_P(line, PSTR("+CIFSR:"), 7))
+			break;
+		return true;
+	case WIFI_CMD_CWJAPQ:
+		if ((sp = ESP8266Detail::_quoted(line, PSTR("+CWJAP:\""))) == NULL)
+			break;
+		// The inquiry by maintain takes BSSID alone.
+		if (slot->reply != _bssid)
+			ESP8266Detail::_unquote((char *)slot->reply, sp, ESP8266_SSID_SIZE);
+		// "+CWJAP:"<ssid>","<bssid>",<channel>,<rssi>", BSSID of the
+		// maintained access point is cached for the next join.
+		if (_joinSsid && !strncmp(sp, _joinSsid, strlen(_joinSsid)) && sp[strlen(_joinSsid)] == '"'
+			&& (sp = strstr_P(sp, PSTR("\",\""))) != NULL
+			&& strlen(sp + 3) > ESP8266_BSSID_SIZE && sp[ESP8266_BSSID_SIZE + 2] == '"') {
+			ESP8266Detail::_unquote(_bssid, sp + 3, ESP8266_BSSID_SIZE);
+			_bssidChannel = (uint8_t)atoi(sp + ESP8266_BSSID_SIZE + 4);
+		}
+		return true;
+	case WIFI_CMD_CIPSTATUS:
+		if (!strncmp_P(line, PSTR("STATUS:"), 7)) {
+			switch (line[7]) {
+			case '2':
+				*(WIFI_STATUS *)slot->reply = WIFI_STATUS_GOTIP;
+				break;
+			case '3':
+				*(WIFI_STATUS *)slot->reply = WIFI_STATUS_CONN;
+				break;
+			case '4':
+				*(WIFI_STATUS *)slot->reply = WIFI_STATUS_DISCONN;
+				break;
+			case '5':
+				*(WIFI_STATUS *)slot->reply = WIFI_STATUS_NOTCONN;
+				break;
+			}
+			return true;
+		}
+		if (!strncmp_P(line, PSTR("+CIPSTATUS:"), 11))
+			return true;
+		break;
+	case WIFI_CMD_CIPDOMAIN:
+		if ((sp = ESP8266Detail::_quoted(line, PSTR("+CIPDOMAIN:"))) == NULL)
+			break;
+		if (*sp == '"')
+			sp++;
+		ESP8266Detail::_unquote((char *)slot->reply, sp, sizeof(((WIFI_DNSENTRY *)0)->ip));
+		return true;
+	case WIFI_CMD_CWLAP:
+		if ((sp = ESP8266Detail::_quoted(line, PSTR("+CWLAP:("))) == NULL)
+			break;
+		ESP8266Detail::_scanEntry((WIFI_SCAN *)slot->reply, sp);
+		return true;
+#ifdef ESP8266_USE_DNSCACHE
+	case WIFI_CMD_CIPSTART:
+		// The connect fails by these without the fault of the cached
+		// address, it is kept. The line goes on to the notice.
+		if (!strcmp_P(line, PSTR("ALREADY CONNECTED")) || !strcmp_P(line, PSTR("no ip")))
+			slot->reply = NULL;
+		break;
+#endif
+	case WIFI_CMD_CIPSEND:
+		// Acknowledgment of the forwarded data
+		if (!strncmp_P(line, PSTR("Recv "), 5))
+			return true;
+		break;
+	default:
+		break;
+	}
+	// Echo back of the command
+	return !strncmp_P(line, PSTR("AT"), 2);
+}
+
+/**
+ * Hand the unsolicited line to the notice handler.
+ * @parameter	line	Unsolicited line
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_notice(const char *line) {
+	uint8_t	channel;
+
+	// "<id>,CONNECT" and "<id>,CLOSED" change the connection ID.
+	if (line[0] >= '0' && line[0] <= '9' && line[1] == ',') {
+		channel = line[0] - '0';
+		if (channel < ESP8266_RX_CHANNELS) {
+			if (!strcmp_P(line + 2, PSTR("CLOSED"))) {
+#ifdef ESP8266_USE_POOL
+				_pool[channel].state = WIFI_POOL_FREE;
+#endif
+				if (_client[channel].connected) {
+					_client[channel].connected = false;
+					_client[channel].events |= WIFI_EVENT_CLOSE;
+				}
+			} else if (!strcmp_P(line + 2, PSTR("CONNECT"))) {
+#ifdef ESP8266_USE_POOL
+				// The connection from the remote is not pooled.
+				if (_pool[channel].state == WIFI_POOL_FREE) {
+					_pool[channel].host[0] = '\0';
+					_pool[channel].state = WIFI_POOL_BUSY;
+				}
+#endif
+				// A new client starts with the empty buffer.
+				if (_conn == WIFI_CONN_SERVER || _conn == WIFI_CONN_PEER) {
+					memset(&_rx[channel], 0, sizeof(WIFI_RXBUF));
+					_client[channel].connected = true;
+					_client[channel].accepted = true;
+					_client[channel].connectedAt = millis();
+					_client[channel].context = NULL;
+					_client[channel].events |= WIFI_EVENT_CONNECT;
+				}
+			}
+		}
+	}
+	// The station state drives the rejoining.
+	if (!strcmp_P(line, PSTR("WIFI DISCONNECT"))) {
+		if (_joinState == WIFI_JOIN_UP || _joinState == WIFI_JOIN_LEARNING) {
+			_joinStat.drops++;
+			_joinState = WIFI_JOIN_DOWN;
+			_joinAt = _downAt = millis();
+			_downTiming = true;
+		}
+	} else if (!strcmp_P(line, PSTR("WIFI GOT IP"))) {
+		// The module may have rejoined by itself.
+		if (_joinState == WIFI_JOIN_DOWN) {
+			_joinState = WIFI_JOIN_UP;
+			_joinRetries = 0;
+		}
+		_joined();
+	}
+	if (_onNotice)
+		_onNotice(line);
+}
+
+/**
+ * Set the handler of the unsolicited line.
+ * The line which is not a part of the response to the command such
+ * as "0,CONNECT", "1,CLOSED" and "WIFI DISCONNECT" is handed to the
+ * handler without the newline. It is called from poll, so the handler
+ * should not issue the command by the blocking method.
+ * @parameter	handler	Notice handler, NULL to stop the notification
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::onNotice(WIFI_NOTICE handler) {
+	_onNotice = handler;
+}
+
+/**
+ * Get the result of the asynchronous command.
+ * The result is kept until the slot of the command is reused by
+ * the subsequent command.
+ * @parameter	handle	Handle of the command
+ * @return	<code>WIFI_ERR_PENDING</code> while the command is in progress,
+ *	the concluded condition otherwise. <code>WIFI_ERR_ERROR</code>
+ *	for the unknown handle.
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::result(WIFI_HANDLE handle) {
+	uint8_t	i;
+
+	if (handle >= 0)
+		for (i = 0; i < ESP8266_CMD_SLOTS; i++)
+			if (_cmd[i].handle == handle)
+				return _cmd[i].state == WIFI_CMDST_DONE ? _cmd[i].result : WIFI_ERR_PENDING;
+	return WIFI_ERR_ERROR;
+}
+
+/**
+ * Wait for the conclusion of the asynchronous command.
+ * @parameter	handle	Handle of the command
+ * @return		WIFI_ERR
+ */
+template<class SerialT, class Policy>
+WIFI_ERR ESP8266Driver<SerialT, Policy>::wait(WIFI_HANDLE handle) {
+	WIFI_ERR	err;
+	bool		waiting = _waiting;
+
+	// The sketch drains nothing until the conclusion.
+	_waiting = true;
+	while ((err = result(handle)) == WIFI_ERR_PENDING)
+		(void)poll();
+	_waiting = waiting;
+	return err;
+}
+
+/**
+ * Set the pipeline depth.
+ * The commands up to the depth are written out back to back without
+ * waiting for the reply of the preceding command. The replies are
+ * matched with the commands in the issued order. The depth 1 waits
+ * for each reply as usual. It is limited to ESP8266_CMD_SLOTS.
+ * Note that the module answers "busy" to the command which arrived
+ * while processing the preceding one. The busy is taken by the oldest
+ * command behind the one in process, which concludes with
+ * WIFI_ERR_BUSY ahead of it. The command is not retried.
+ * @parameter	depth	Number of the commands to be in progress
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::pipeline(uint8_t depth) {
+	if (depth < 1)
+		depth = 1;
+	else if (depth > ESP8266_CMD_SLOTS)
+		depth = ESP8266_CMD_SLOTS;
+	_cmdDepth = depth;
+}
+
+#ifdef ESP8266_USE_METRICS
+/**
+ * Take a snapshot of the metrics.
+ * @parameter	snapshot	Buffer to store the metrics
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::stats(WIFI_STATS *snapshot) {
+	memcpy(snapshot, &_stats, sizeof(WIFI_STATS));
+}
+
+/**
+ * Clear the metrics.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::resetStats(void) {
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+/**
+ * Count the concluded command into the metrics.
+ * @parameter	slot	Concluded command
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_measure(const WIFI_CMDSLOT *slot) {
+	WIFI_CMDSTAT	*stat = &_stats.command[slot->cmd];
+	uint32_t	elapsed = millis() - slot->issuedAt;
+	uint8_t		bucket = 0;
+
+	while (elapsed && bucket < ESP8266_METRICS_BUCKETS - 1) {
+		elapsed >>= 1;
+		bucket++;
+	}
+	stat->count++;
+	stat->latency[bucket]++;
+	switch (slot->result) {
+	case WIFI_ERR_TIMEOUT:
+		_stats.timeouts++;
+		break;
+	case WIFI_ERR_BUSY:
+		_stats.busy++;
+		break;
+	default:
+		break;
+	}
+}
+#endif
+
+/**
+ * Inquire whether the command is in progress.
+ * @return		true	The command is in progress
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_progress(void) {
+	return _cmdCount != 0;
+}
+
+/**
+ * Inquire whether the new command can be issued.
+ * The command is not accepted during the transparent transmission.
+ * The command waiting for the prompt occupies the line alone because
+ * the data follows the command.
+ * @parameter	exclusive	The command waits for the prompt
+ * @return		true	The command can be issued
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_ready(bool exclusive) {
+	uint8_t	i;
+
+	if (_transparent)
+		return false;
+	if (!_cmdCount)
+		return true;
+	if (exclusive || _cmdCount >= _cmdDepth)
+		return false;
+	for (i = 0; i < _cmdCount; i++)
+		if (_cmd[(_cmdHead + i) % ESP8266_CMD_SLOTS].segment)
+			return false;
+	return true;
+}
+
+/**
+ * Wait until the new command can be issued.
+ * @parameter	exclusive	The command waits for the prompt
+ * @return		true	The command can be issued
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_vacant(bool exclusive) {
+	bool	waiting = _waiting;
+
+	_waiting = true;
+	while (!_ready(exclusive) && poll())
+		;
+	_waiting = waiting;
+	return _ready(exclusive);
+}
+
+/**
+ * Inquire whether the command is in progress or has succeeded.
+ * @parameter	handle	Handle of the command
+ * @return		true	The command has not failed
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_hopeful(WIFI_HANDLE handle) {
+	WIFI_ERR	err = result(handle);
+
+	return err == WIFI_ERR_PENDING || err == WIFI_ERR_OK;
+}
+
+/**
+ * Wait until all commands in progress conclude.
+ * The blocking methods precede this so as not to take the reply
+ * of the asynchronous command.
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_idle(void) {
+	bool	waiting = _waiting;
+
+	_waiting = true;
+	while (poll())
+		;
+	_waiting = waiting;
+}
+
+/**
+ * Get the slot for the command to be issued next.
+ * @return		Command slot
+ */
+template<class SerialT, class Policy>
+WIFI_CMDSLOT *ESP8266Driver<SerialT, Policy>::_tail(void) {
+	return &_cmd[(_cmdHead + _cmdCount) % ESP8266_CMD_SLOTS];
+}
+
+/**
+ * Register the command that has been written out.
+ * @parameter	cmd			Issued AT command
+ * @parameter	timeOut		Time-out of each step with millisecond unit
+ * @parameter	callback	Completion notification
+ * @parameter	segment		Sending data at the prompt, NULL if no prompt
+ * @parameter	segments	Number of the sending segments
+ * @return		WIFI_HANDLE	Handle of the command
+ */
+template<class SerialT, class Policy>
+WIFI_HANDLE ESP8266Driver<SerialT, Policy>::_submit(WIFI_CMD cmd, uint32_t timeOut, WIFI_CALLBACK callback, const WIFI_SEGMENT *segment, uint8_t segments) {
+	WIFI_CMDSLOT	*slot = _tail();
+
+	slot->handle = _handle;
+	_handle = (_handle + 1) & 0x7f;
+	slot->cmd = cmd;
+	slot->state = segment ? WIFI_CMDST_PROMPT : WIFI_CMDST_RESPONSE;
+	slot->result = WIFI_ERR_PENDING;
+	slot->startAt = millis();
+	slot->timeOut = timeOut;
+	slot->segment = segment;
+	slot->segments = segments;
+	slot->callback = callback;
+	ESP8266_Metric(slot->issuedAt = slot->startAt);
+	_cmdCount++;
+	return slot->handle;
+}
+
+/**
+ * Drive the oldest command in progress by the detected term.
+ * @parameter	condition	Condition of the detected term
+ * @return		true	The command concluded
+ */
+template<class SerialT, class Policy>
+bool ESP8266Driver<SerialT, Policy>::_advance(WIFI_ERR condition) {
+	WIFI_CMDSLOT	*slot = &_cmd[_cmdHead];
+	WIFI_CMDSLOT	*behind;
+	uint8_t		i;
+
+	// The line of the detected term belongs to the command unless
+	// it is unsolicited for the command.
+	_lineTaken = true;
+	// The restart concludes only by "ready", the boot messages
+	// are ignored.
+	if (slot->cmd == WIFI_CMD_RST)
+		return false;
+	switch (condition) {
+	case WIFI_ERR_CONNECT:
+	case WIFI_ERR_CLOSED:
+		// Intermediate conditions, it concludes by the subsequent
+		// result code. The term of the other connection ID and the
+		// term within the line such as "WIFI DISCONNECT" are
+		// unsolicited for the command, they go to the notice.
+		// The line lacks CR and LF of CONNECT, and D of CLOSED yet.
+		if ((condition == WIFI_ERR_CONNECT && slot->cmd == WIFI_CMD_CIPSTART
+			&& ESP8266Detail::_linkTerm(_line, _lineLen, PSTR("CONNECT"), slot->channel)) ||
+			(condition == WIFI_ERR_CLOSED && slot->cmd == WIFI_CMD_CIPCLOSE
+			&& ESP8266Detail::_linkTerm(_line, _lineLen, PSTR("CLOSE"), slot->channel)))
+			slot->result = condition;
+		else
+			_lineTaken = false;
+		return false;
+	case WIFI_ERR_PROMPT:
+		if (slot->state != WIFI_CMDST_PROMPT) {
+			_lineTaken = false;
+			return false;
+		}
+		// CIPSEND without the data enters the transparent transmission.
+		if (!slot->segments) {
+			_transparent = true;
+			condition = WIFI_ERR_OK;
+			break;
+		}
+		// Forward the data at the prompt, and then wait for SEND OK.
+		_write(slot->segment, slot->segments);
+		slot->state = WIFI_CMDST_SENDOK;
+		slot->startAt = millis();
+		return false;
+	case WIFI_ERR_OK:
+		// CIPSEND answers OK in front of the prompt.
+		if (slot->state != WIFI_CMDST_RESPONSE)
+			return false;
+		if (slot->result != WIFI_ERR_PENDING)
+			condition = slot->result;
+		break;
+	case WIFI_ERR_SENDOK:
+		if (slot->state != WIFI_CMDST_SENDOK) {
+			_lineTaken = false;
+			return false;
+		}
+		condition = WIFI_ERR_OK;
+		break;
+	case WIFI_ERR_BUSY:
+		// The command arrived while processing the preceding one is
+		// answered busy at once. The busy answers come in the issued
+		// order, so it belongs to the oldest command behind which has
+		// not concluded yet.
+		for (i = 1; i < _cmdCount; i++) {
+			behind = &_cmd[(_cmdHead + i) % ESP8266_CMD_SLOTS];
+			if (behind->state != WIFI_CMDST_DONE) {
+				_finish(behind, condition);
+				return false;
+			}
+		}
+		break;
+	default:
+		// If NACK detected after the data forwarding, it is
+		// regarded as an error.
+		if (slot->state == WIFI_CMDST_SENDOK) {
+			ESP8266_Metric(_stats.sendFails++);
+			condition = WIFI_ERR_ERROR;
+		}
+		break;
+	}
+	_conclude(condition);
+	return true;
+}
+
+/**
+ * Conclude the oldest command in progress.
+ * The commands behind which have concluded out of the order are
+ * passed along with it. The next command starts measuring its
+ * time-out.
+ * @parameter	err		Concluded condition
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_conclude(WIFI_ERR err) {
+	WIFI_CMDSLOT	*slot = &_cmd[_cmdHead];
+
+	do
+		_cmdHead = (_cmdHead + 1) % ESP8266_CMD_SLOTS;
+	while (--_cmdCount && _cmd[_cmdHead].state == WIFI_CMDST_DONE);
+	if (_cmdCount)
+		_cmd[_cmdHead].startAt = millis();
+	_finish(slot, err);
+}
+
+/**
+ * Store the result of the command.
+ * It reflects the result to the connection topology and notifies
+ * the completion. The command concluded out of the order stays in
+ * the queue until the commands ahead conclude.
+ * @parameter	slot	Concluded command
+ * @parameter	err		Concluded condition
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_finish(WIFI_CMDSLOT *slot, WIFI_ERR err) {
+	slot->state = WIFI_CMDST_DONE;
+	slot->result = err;
+	slot->segment = NULL;
+	ESP8266_Metric(_measure(slot));
+	switch (slot->cmd) {
+	case WIFI_CMD_CIPSTART:
+		// The server keeps accepting the clients along with the connection.
+		if (err == WIFI_ERR_CONNECT) {
+			_conn = _conn == WIFI_CONN_SERVER || _conn == WIFI_CONN_PEER ? WIFI_CONN_PEER : WIFI_CONN_CLIENT;
+#ifdef ESP8266_USE_POOL
+			// The connection aside from acquire is not pooled, acquire
+			// takes over the slot of its own connection.
+			if (slot->channel >= 0 && slot->channel < ESP8266_RX_CHANNELS
+				&& _pool[slot->channel].state == WIFI_POOL_FREE) {
+				_pool[slot->channel].host[0] = '\0';
+				_pool[slot->channel].state = WIFI_POOL_BUSY;
+			}
+#endif
+		}
+#ifdef ESP8266_USE_DNSCACHE
+		else if (slot->reply && (err == WIFI_ERR_ERROR || err == WIFI_ERR_TIMEOUT)) {
+			// The cached address may be obsolete.
+			((WIFI_DNSENTRY *)slot->reply)->host[0] = '\0';
+			_dnsStat.invalidated++;
+		}
+#endif
+		break;
+	case WIFI_CMD_CIPSERVER:
+		if (err == WIFI_ERR_OK)
+			_conn = _conn == WIFI_CONN_CLIENT || _conn == WIFI_CONN_PEER ? WIFI_CONN_PEER : WIFI_CONN_SERVER;
+		break;
+	default:
+		break;
+	}
+	_tapResult(slot->cmd, err);
+	if (slot->callback)
+		slot->callback(slot->handle, err);
+}
+
+/**
+ * Tap the result of the command as the line "#<WIFI_CMD>,<WIFI_ERR>".
+ * The failure is tapped at WIFI_TAPLV_ERROR and the others are at
+ * WIFI_TAPLV_INFO.
+ * @parameter	cmd		Concluded command
+ * @parameter	err		Concluded condition
+ */
+template<class SerialT, class Policy>
+void ESP8266Driver<SerialT, Policy>::_tapResult(WIFI_CMD cmd, WIFI_ERR err) {
+	char		note[12];
+	uint8_t		len = 0;
+	WIFI_TAPLV	level;
+
+	note[len++] = '#';
+	if (cmd >= 10)
+		note[len++] = (char)('0' + cmd / 10);
+	note[len++] = (char)('0' + cmd % 10);
+	note[len++] = ',';
+	if (err < 0)
+		note[len++] = '-';
+	note[len++] = (char)('0' + (err < 0 ? -err : err));
+	note[len++] = '\r';
+	note[len++] = '\n';
+	switch (err) {
+	case WIFI_ERR_TIMEOUT:
+	case WIFI_ERR_ERROR:
+	case WIFI_ERR_BUSY:
+	case WIFI_ERR_SENDFAIL:
+		level = WIFI_TAPLV_ERROR;
+		break;
+	default:
+		level = WIFI_TAPLV_INFO;
+		break;
+	}
+	Policy::tap(WIFI_TAP_EVENT, level, (const uint8_t *)note, len);
+}
+
+// The private macros are not exported to the sketch.
+#undef ESP8266_AT_ATE
+#undef ESP8266_Metric
+#undef ESP8266_AT_UART
+#undef ESP8266_AT_CWMODE
+#undef ESP8266_AT_CWJAP
@@ -0,0 +1,240 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	ESP8266Http class implementation, the incremental parser of
+	HTTP/1.1 response with the chunked transfer coding.
+*/
+
+#include "ESP8266Http.h"
+
+/**
+ * ESP8266Http class constructor.
+ * @parameter	body	Body handler, NULL to discard the body
+ * @parameter	header	Header handler, NULL if not needed
+ */
+ESP8266Http::ESP8266Http(HTTP_BODY body, HTTP_HEADER header) : _onBody(body), _onHeader(header) {
+	reset();
+}
+
+/**
+ * Prepare for the next response.
+ */
+void ESP8266Http::reset(void) {
+	_phase = HTTP_PHASE_STATUS;
+	_status = 0;
+	_length = -1;
+	_remain = 0;
+	_chunked = false;
+	_lineLen = 0;
+}
+
+/**
+ * Feed the received data to the parser.
+ * The data can be divided at any position. The parsing stops when
+ * the response completed or the body handler returned false, and the
+ * following data is not consumed.
+ * @parameter	data	Received data
+ * @parameter	length	Length of the data
+ * @return		Consumed length
+ */
+uint16_t ESP8266Http::parse(const uint8_t *data, uint16_t length) {
+	uint16_t	consumed = 0;
+	uint8_t		c;
+
+	while (consumed < length && !done()) {
+		switch (_phase) {
+		case HTTP_PHASE_BODY:
+		case HTTP_PHASE_CHUNK_DATA:
+			// The body is handed as it is without copying.
+			consumed += _deliver(data + consumed, length - consumed);
+			break;
+		default:
+			// The others are parsed by the line.
+			c = data[consumed++];
+			if (c == '\n') {
+				_line[_lineLen] = '\0';
+				_parseLine();
+				_lineLen = 0;
+			} else if (c != '\r' && _lineLen < ESP8266_HTTP_LINE_SIZE - 1)
+				_line[_lineLen++] = (char)c;
+			break;
+		}
+	}
+	return consumed;
+}
+
+/**
+ * Get the parsing phase.
+ * @return		HTTP_PHASE
+ */
+HTTP_PHASE ESP8266Http::phase(void) {
+	return _phase;
+}
+
+/**
+ * Get the status code of the response.
+ * @return		Status code, 0 until the status line arrives
+ */
+int16_t ESP8266Http::status(void) {
+	return _status;
+}
+
+/**
+ * Get the value of Content-Length.
+ * @return		Content-Length, -1 if not specified
+ */
+int32_t ESP8266Http::contentLength(void) {
+	return _length;
+}
+
+/**
+ * Inquire whether the body is in the chunked transfer coding.
+ * @return		true	Chunked
+ */
+bool ESP8266Http::chunked(void) {
+	return _chunked;
+}
+
+/**
+ * Inquire whether the parsing has finished.
+ * The body which has no Content-Length and is not chunked continues
+ * until the connection closed, it never finishes.
+ * @return		true	Completed, aborted or malformed
+ */
+bool ESP8266Http::done(void) {
+	return _phase >= HTTP_PHASE_DONE;
+}
+
+/**
+ * Parse the completed line according to the phase.
+ */
+void ESP8266Http::_parseLine(void) {
+	switch (_phase) {
+	case HTTP_PHASE_STATUS:
+		// Empty lines preceding the status line are ignored.
+		if (_lineLen)
+			_parseStatus();
+		break;
+	case HTTP_PHASE_HEADER:
+		if (_lineLen)
+			_parseHeader();
+		else
+			_startBody();
+		break;
+	case HTTP_PHASE_CHUNK_SIZE:
+		_parseChunkSize();
+		break;
+	case HTTP_PHASE_CHUNK_END:
+		_phase = _lineLen ? HTTP_PHASE_ERROR : HTTP_PHASE_CHUNK_SIZE;
+		break;
+	case HTTP_PHASE_TRAILER:
+		if (_lineLen)
+			_parseHeader();
+		else
+			_phase = HTTP_PHASE_DONE;
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Parse the status line as "HTTP/1.1 200 OK".
+ */
+void ESP8266Http::_parseStatus(void) {
+	const char	*sp;
+
+	if (strncmp_P(_line, PSTR("HTTP/"), 5) || (sp = strchr(_line, ' ')) == NULL) {
+		_phase = HTTP_PHASE_ERROR;
+		return;
+	}
+	_status = (int16_t)atoi(sp + 1);
+	_phase = _status > 0 ? HTTP_PHASE_HEADER : HTTP_PHASE_ERROR;
+}
+
+/**
+ * Parse the header line as "Name: value".
+ * Content-Length and Transfer-Encoding are taken by the parser, and
+ * all headers are handed to the header handler.
+ */
+void ESP8266Http::_parseHeader(void) {
+	char	*value;
+
+	if ((value = strchr(_line, ':')) == NULL)
+		return;
+	*value++ = '\0';
+	while (*value == ' ' || *value == '\t')
+		value++;
+	if (!strcasecmp_P(_line, PSTR("Content-Length")))
+		_length = (int32_t)strtoul(value, NULL, 10);
+	else if (!strcasecmp_P(_line, PSTR("Transfer-Encoding")))
+		_chunked = strstr_P(value, PSTR("chunked")) != NULL;
+	if (_onHeader)
+		_onHeader(_line, value);
+}
+
+/**
+ * Parse the chunk size line, the chunk extension is ignored.
+ */
+void ESP8266Http::_parseChunkSize(void) {
+	const char	*sp = _line;
+	uint8_t		digit;
+
+	if (!isxdigit(*sp)) {
+		_phase = HTTP_PHASE_ERROR;
+		return;
+	}
+	_remain = 0;
+	while (isxdigit(*sp)) {
+		digit = *sp <= '9' ? *sp - '0' : (*sp | 0x20) - 'a' + 10;
+		_remain = (_remain << 4) | digit;
+		sp++;
+	}
+	// The last chunk is followed by the trailer.
+	_phase = _remain ? HTTP_PHASE_CHUNK_DATA : HTTP_PHASE_TRAILER;
+}
+
+/**
+ * Determine the form of the body by the headers.
+ */
+void ESP8266Http::_startBody(void) {
+	// The interim response is followed by the final response.
+	if (_status < 200) {
+		reset();
+		return;
+	}
+	// Content-Length is ignored with the chunked transfer coding.
+	if (_chunked)
+		_phase = HTTP_PHASE_CHUNK_SIZE;
+	else if (_status == 204 || _status == 304 || _length == 0)
+		_phase = HTTP_PHASE_DONE;
+	else {
+		_phase = HTTP_PHASE_BODY;
+		_remain = (uint32_t)_length;
+	}
+}
+
+/**
+ * Hand the body to the body handler.
+ * @parameter	data	Body data
+ * @parameter	length	Length of the data
+ * @return		Consumed length
+ */
+uint16_t ESP8266Http::_deliver(const uint8_t *data, uint16_t length) {
+	// The body without Content-Length continues until closed.
+	bool	bounded = _phase == HTTP_PHASE_CHUNK_DATA || _length >= 0;
+
+	if (bounded && length > _remain)
+		length = (uint16_t)_remain;
+	if (_onBody && !_onBody(data, length)) {
+		_phase = HTTP_PHASE_ABORT;
+		return length;
+	}
+	if (bounded && (_remain -= length) == 0)
+		_phase = _phase == HTTP_PHASE_CHUNK_DATA ? HTTP_PHASE_CHUNK_END : HTTP_PHASE_DONE;
+	return length;
+}
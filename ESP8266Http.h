@@ -0,0 +1,107 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	This is the #include header of the HTTP/1.1 response parser.
+	The parser is fed the received data piece by piece as it arrives
+	through +IPD frames, and it hands the status, the headers and the
+	body to the sketch without buffering the whole response. It
+	allocates no memory except a line buffer in the instance.
+*/
+
+#ifndef __ESP8266HTTP_H__
+#define __ESP8266HTTP_H__
+
+#include "ESP8266.h"
+
+// Maximum length of the status line and the header line including
+// the terminator. The excess is truncated.
+#define ESP8266_HTTP_LINE_SIZE	64
+
+// Parsing phase of the response
+typedef enum {
+	HTTP_PHASE_STATUS,						// Status line
+	HTTP_PHASE_HEADER,						// Header lines
+	HTTP_PHASE_BODY,						// Body by Content-Length or until closed
+	HTTP_PHASE_CHUNK_SIZE,					// Chunk size line
+	HTTP_PHASE_CHUNK_DATA,					// Chunk data
+	HTTP_PHASE_CHUNK_END,					// CRLF following the chunk data
+	HTTP_PHASE_TRAILER,						// Trailer lines following the last chunk
+	HTTP_PHASE_DONE,						// The response completed
+	HTTP_PHASE_ABORT,						// Stopped by the body handler
+	HTTP_PHASE_ERROR						// Malformed response
+} HTTP_PHASE;
+
+// Notification of the header, the name and the value are terminated.
+typedef void (*HTTP_HEADER)(const char *name, const char *value);
+// Notification of the body, return false to stop the parsing.
+// The data is decoded from the chunked transfer coding.
+typedef bool (*HTTP_BODY)(const uint8_t *data, uint16_t length);
+
+// ESP8266Http class declaration
+class ESP8266Http {
+
+private:
+	// Private members
+	HTTP_BODY	_onBody;					// Body handler
+	HTTP_HEADER	_onHeader;					// Header handler
+	HTTP_PHASE	_phase;						// Parsing phase
+	int16_t		_status;					// Status code
+	int32_t		_length;					// Content-Length, -1 if unknown
+	uint32_t	_remain;					// Remaining length of the body or the chunk
+	bool		_chunked;					// Transfer-Encoding: chunked
+	char		_line[ESP8266_HTTP_LINE_SIZE];	// Line being parsed
+	uint8_t		_lineLen;					// Length of the line
+
+	// Private methods
+	void		_parseLine(void);
+	void		_parseStatus(void);
+	void		_parseHeader(void);
+	void		_parseChunkSize(void);
+	void		_startBody(void);
+	uint16_t	_deliver(const uint8_t *data, uint16_t length);
+
+public:
+	// Constructor
+	ESP8266Http(HTTP_BODY body = NULL, HTTP_HEADER header = NULL);
+	// Prepare for the next response.
+	void		reset(void);
+	// Feed the received data, returns consumed length.
+	uint16_t	parse(const uint8_t *data, uint16_t length);
+	// Feed the data which has arrived at the connection.
+	template<class SerialT, class Policy>
+	uint16_t	parse(ESP8266Driver<SerialT, Policy> &wifi, int8_t channel = -1);
+	// Get the parsing phase.
+	HTTP_PHASE	phase(void);
+	// Get the status code, 0 until the status line arrives.
+	int16_t		status(void);
+	// Get Content-Length, -1 if not specified.
+	int32_t		contentLength(void);
+	// Inquire whether the body is chunked.
+	bool		chunked(void);
+	// Inquire whether the parsing has finished.
+	bool		done(void);
+};
+
+/**
+ * Feed the data which has arrived at the connection to the parser.
+ * The data following the completed response would be discarded.
+ * @parameter	wifi	ESP8266 instance which receives the response
+ * @parameter	channel	Connection ID, -1 for the single connection
+ * @return		Consumed length
+ */
+template<class SerialT, class Policy>
+uint16_t ESP8266Http::parse(ESP8266Driver<SerialT, Policy> &wifi, int8_t channel) {
+	uint8_t		buffer[32];
+	uint16_t	consumed = 0;
+	int16_t		n;
+
+	while (!done() && (n = wifi.read(channel, buffer, sizeof(buffer))) > 0)
+		consumed += parse(buffer, (uint16_t)n);
+	return consumed;
+}
+
+#endif	/* __ESP8266HTTP_H__ */
@@ -0,0 +1,212 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	ESP8266Replay class implementation, the playback of the trace
+	captured by ESP8266Trace.
+*/
+
+#include "ESP8266Trace.h"
+
+/**
+ * Encode the number by 7 bits per byte from the lower bits.
+ * The most significant bit of the byte indicates the continuation.
+ * @parameter	dest	Destination of 5 bytes at the most
+ * @parameter	n		Number to be encoded
+ * @return		Encoded length
+ */
+uint8_t _traceNumber(uint8_t *dest, uint32_t n) {
+	uint8_t		len = 0;
+
+	while (n > 0x7f) {
+		dest[len++] = (uint8_t)(n | 0x80);
+		n >>= 7;
+	}
+	dest[len++] = (uint8_t)n;
+	return len;
+}
+
+/**
+ * ESP8266Replay class constructor.
+ * The trace is referred without copying, it must be kept until the
+ * replay completes.
+ * @parameter	trace	Trace captured by ESP8266Trace
+ * @parameter	size	Size of the trace
+ * @parameter	speed	Acceleration of the recorded timing, 1 for the real
+ *						timing and 0 to hand the data without waiting
+ * @parameter	clock	Clock with microsecond unit, NULL for micros
+ */
+ESP8266Replay::ESP8266Replay(const uint8_t *trace, uint32_t size, uint16_t speed, WIFI_CLOCK clock) : _trace(trace), _size(size), _speed(speed), _clock(clock) {
+	restart();
+}
+
+/**
+ * Rewind the trace and restart the replay.
+ * The trace of the unknown format is treated as empty.
+ */
+void ESP8266Replay::restart(void) {
+	_pos = _size;
+	if (_size >= 3 && _trace[0] == ESP8266_TRACE_MAGIC0 && _trace[1] == ESP8266_TRACE_MAGIC1 && _trace[2] == ESP8266_TRACE_VERSION)
+		_pos = 3;
+	_remain = 0;
+	_mark = _now();
+	_startAt = _mark;
+	memset(&_stat, 0, sizeof(_stat));
+}
+
+/**
+ * Inquire whether the whole trace has been replayed.
+ * @return		true	All records are replayed
+ */
+bool ESP8266Replay::done(void) {
+	return !_next();
+}
+
+/**
+ * Get the statistics of the replay.
+ * @return		WIFI_REPLAYSTAT
+ */
+WIFI_REPLAYSTAT ESP8266Replay::stat(void) {
+	_stat.elapsed = (_now() - _startAt) / 1000;
+	return _stat;
+}
+
+/**
+ * Get the number of the bytes ready for the driver.
+ * The received record is ready when the recorded interval has passed
+ * since the previous record began.
+ * @return		Number of bytes
+ */
+int ESP8266Replay::available(void) {
+	if (!_next() || _tx)
+		return 0;
+	if (!_started) {
+		if (!_due())
+			return 0;
+		_started = true;
+		_mark = _now();
+		_stat.records++;
+	}
+	return _remain;
+}
+
+/**
+ * Peek the next byte to the driver.
+ * @return		Byte, -1 if not ready
+ */
+int ESP8266Replay::peek(void) {
+	return available() > 0 ? _trace[_pos] : -1;
+}
+
+/**
+ * Hand the next byte to the driver.
+ * @return		Byte, -1 if not ready
+ */
+int ESP8266Replay::read(void) {
+	if (available() <= 0)
+		return -1;
+	_remain--;
+	_stat.rxBytes++;
+	return _trace[_pos++];
+}
+
+/**
+ * Accept the data from the driver and compare it with the trace.
+ * The data written ahead of the pending received record is counted
+ * as the mismatch entirely.
+ * @parameter	data	Written data
+ * @parameter	length	Length of the data
+ * @return		Length of the data
+ */
+size_t ESP8266Replay::write(const uint8_t *data, size_t length) {
+	size_t		n;
+
+	for (n = 0; n < length; n++) {
+		_stat.txBytes++;
+		if (!_next() || !_tx) {
+			_stat.mismatches++;
+			continue;
+		}
+		if (!_started) {
+			_started = true;
+			_mark = _now();
+			_stat.records++;
+		}
+		if (_trace[_pos++] != data[n])
+			_stat.mismatches++;
+		_remain--;
+	}
+	return length;
+}
+
+/**
+ * Advance to the next record when the current one has been consumed.
+ * The control record is skipped.
+ * @return		false	The trace has been exhausted
+ */
+bool ESP8266Replay::_next(void) {
+	uint8_t		header;
+
+	while (!_remain) {
+		if (_pos >= _size)
+			return false;
+		header = _trace[_pos++];
+		if (!(header & ESP8266_TRACE_LENGTH)) {
+			(void)_number();
+			continue;
+		}
+		_tx = (header & ESP8266_TRACE_TX) != 0;
+		_delta = _number();
+		_started = false;
+		_remain = header & ESP8266_TRACE_LENGTH;
+		if (_remain > _size - _pos)
+			_remain = (uint8_t)(_size - _pos);
+	}
+	return true;
+}
+
+/**
+ * Decode the variable length number.
+ * @return		Decoded number
+ */
+uint32_t ESP8266Replay::_number(void) {
+	uint32_t	n = 0;
+	uint8_t		shift = 0;
+	uint8_t		b;
+
+	do {
+		if (_pos >= _size)
+			break;
+		b = _trace[_pos++];
+		if (shift < 32)
+			n |= (uint32_t)(b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return n;
+}
+
+/**
+ * Inquire whether the recorded interval of the current record has
+ * passed with the acceleration.
+ * @return		true	The record is due
+ */
+bool ESP8266Replay::_due(void) {
+	if (!_speed)
+		return true;
+	return _now() - _mark >= _delta / _speed;
+}
+
+/**
+ * Get the time of the replay.
+ * Without waiting and without the clock, the time stays 0 so that the
+ * replay runs where the timing functions are not available.
+ * @return		Time with microsecond unit
+ */
+uint32_t ESP8266Replay::_now(void) {
+	if (_clock)
+		return _clock();
+	return _speed ? micros() : 0;
+}
@@ -0,0 +1,301 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	This is the #include header of the trace capture and the replay of
+	the serial link with ESP8266. The capture wraps the serial of the
+	driver and records both directions with the timing to a compact
+	binary trace. The replay stands in for the serial and plays the
+	trace back to the driver, so the stalls taken in the field can be
+	reproduced and the parser can be measured with the real traffic.
+*/
+
+#ifndef __ESP8266TRACE_H__
+#define __ESP8266TRACE_H__
+
+#include "ESP8266.h"
+
+// Trace format
+// The trace begins with the magic "ET" and the version, and a sequence
+// of the records follows. A record begins with the header byte, the
+// most significant bit is the direction and the rest is the length of
+// the data. The time from the previous record is followed by the
+// microsecond unit in the variable length encoding of 7 bits per byte,
+// and the data follows. The header of zero length is the control record
+// which has the baud rate in the same encoding instead of the time.
+#define ESP8266_TRACE_MAGIC0	'E'
+#define ESP8266_TRACE_MAGIC1	'T'
+#define ESP8266_TRACE_VERSION	1
+#define ESP8266_TRACE_TX		0x80		// Direction bit of the transmission
+#define ESP8266_TRACE_LENGTH	0x7f		// Length bits of the header
+// Maximum data length of the record, the longer run is split.
+#define ESP8266_TRACE_RECORD	32
+// The received data is split into the other record when the interval
+// of the arrival exceeds it with microsecond unit.
+#define ESP8266_TRACE_GAP		2000
+
+// Statistics of the capture
+typedef struct {
+	uint32_t	records;					// Number of the written records
+	uint32_t	rxBytes;					// Captured bytes from ESP8266
+	uint32_t	txBytes;					// Captured bytes to ESP8266
+	uint32_t	lost;						// Bytes the sink could not accept
+} WIFI_TRACESTAT;
+
+// Statistics of the replay
+typedef struct {
+	uint32_t	records;					// Number of the replayed records
+	uint32_t	rxBytes;					// Bytes delivered to the driver
+	uint32_t	txBytes;					// Bytes written by the driver
+	uint32_t	mismatches;					// Written bytes which differ from the trace
+	uint32_t	elapsed;					// Time from the start with millisecond unit, 0 without the clock
+} WIFI_REPLAYSTAT;
+
+// Clock of the replay with microsecond unit, such as the virtual time
+// of the host test or the timer of the sketch.
+typedef uint32_t (*WIFI_CLOCK)(void);
+
+// Append the variable length number to the trace.
+uint8_t	_traceNumber(uint8_t *dest, uint32_t n);
+
+// ESP8266Trace class declaration
+// It has the members of the serial which the driver uses, and passes
+// them through to the wrapped serial.
+template<class SerialT>
+class ESP8266Trace {
+
+private:
+	// Private members
+	SerialT		*_serial;					// Wrapped serial
+	Print		*_sink;						// Destination of the trace, NULL while stopped
+	uint8_t		_rec[ESP8266_TRACE_RECORD];	// Data of the pending record
+	uint8_t		_len;						// Length of the pending record
+	bool		_tx;						// Direction of the pending record
+	uint32_t	_recAt;						// Time of the pending record
+	uint32_t	_byteAt;					// Time of the last byte
+	uint32_t	_lastAt;					// Time of the previous record
+	WIFI_TRACESTAT	_stat;					// Statistics
+
+	// Private methods
+	void		_capture(bool tx, const uint8_t *data, size_t length);
+	void		_emit(void);
+	void		_put(const uint8_t *data, uint8_t length);
+
+public:
+	// Constructor
+	ESP8266Trace(SerialT &serial) : _serial(&serial), _sink(NULL), _len(0) { memset(&_stat, 0, sizeof(_stat)); }
+	// Start the capture to the sink such as a file.
+	void		start(Print &sink);
+	// Write out the pending record and stop the capture.
+	void		stop(void);
+	// Get the statistics of the capture.
+	WIFI_TRACESTAT	stat(void) { return _stat; }
+	// Members of the serial
+	void		begin(uint32_t baudrate);
+	void		end(void) { _serial->end(); }
+	void		setTimeout(unsigned long timeOut) { _serial->setTimeout(timeOut); }
+	int			available(void) { return _serial->available(); }
+	int			peek(void) { return _serial->peek(); }
+	int			read(void);
+	size_t		write(uint8_t c) { return write(&c, 1); }
+	size_t		write(const uint8_t *data, size_t length);
+	void		flush(void) { _serial->flush(); }
+};
+
+// ESP8266Replay class declaration
+// It stands in for the serial of the driver. The received records are
+// handed to the driver after the recorded interval divided by the
+// speed, and after the driver has written the preceding transmission.
+// The written data is compared with the transmission records.
+// The time is taken from the clock given to the constructor, or from
+// micros without it. With the speed of 0 and without the clock, the
+// replay makes no call to the timing functions at all.
+class ESP8266Replay {
+
+private:
+	// Private members
+	const uint8_t	*_trace;				// Trace to be replayed
+	uint32_t	_size;						// Size of the trace
+	uint32_t	_pos;						// Position of the next byte
+	uint16_t	_speed;						// Acceleration, 0 without waiting
+	WIFI_CLOCK	_clock;						// Clock, NULL for micros
+	uint8_t		_remain;					// Remaining data of the current record
+	bool		_tx;						// Direction of the current record
+	bool		_started;					// The current record has begun
+	uint32_t	_delta;						// Recorded interval of the current record
+	uint32_t	_mark;						// Time of the previous record began
+	uint32_t	_startAt;					// Time of the replay started
+	WIFI_REPLAYSTAT	_stat;					// Statistics
+
+	// Private methods
+	uint32_t	_now(void);
+	bool		_next(void);
+	uint32_t	_number(void);
+	bool		_due(void);
+
+public:
+	// Constructor
+	ESP8266Replay(const uint8_t *trace, uint32_t size, uint16_t speed = 1, WIFI_CLOCK clock = NULL);
+	// Rewind the trace and restart the replay.
+	void		restart(void);
+	// Inquire whether the whole trace has been replayed.
+	bool		done(void);
+	// Get the statistics of the replay.
+	WIFI_REPLAYSTAT	stat(void);
+	// Members of the serial
+	void		begin(uint32_t) {}
+	void		end(void) {}
+	void		setTimeout(unsigned long) {}
+	int			available(void);
+	int			peek(void);
+	int			read(void);
+	size_t		write(uint8_t c) { return write(&c, 1); }
+	size_t		write(const uint8_t *data, size_t length);
+	void		flush(void) {}
+};
+
+/**
+ * Start the capture.
+ * The trace header is written to the sink, and the following traffic
+ * is recorded until stop.
+ * @parameter	sink	Destination of the trace
+ */
+template<class SerialT>
+void ESP8266Trace<SerialT>::start(Print &sink) {
+	static const uint8_t	header[] = { ESP8266_TRACE_MAGIC0, ESP8266_TRACE_MAGIC1, ESP8266_TRACE_VERSION };
+
+	_sink = &sink;
+	_len = 0;
+	_lastAt = micros();
+	_put(header, sizeof(header));
+}
+
+/**
+ * Write out the pending record and stop the capture.
+ */
+template<class SerialT>
+void ESP8266Trace<SerialT>::stop(void) {
+	_emit();
+	_sink = NULL;
+}
+
+/**
+ * Begin the serial and record the baud rate by the control record.
+ * @parameter	baudrate	Baud rate
+ */
+template<class SerialT>
+void ESP8266Trace<SerialT>::begin(uint32_t baudrate) {
+	uint8_t		control[6];
+
+	_serial->begin(baudrate);
+	if (!_sink)
+		return;
+	_emit();
+	control[0] = 0;
+	_put(control, _traceNumber(control + 1, baudrate) + 1);
+}
+
+/**
+ * Read a byte and capture it.
+ * @return		Received byte, -1 if not available
+ */
+template<class SerialT>
+int ESP8266Trace<SerialT>::read(void) {
+	int			c = _serial->read();
+	uint8_t		b;
+
+	if (c >= 0) {
+		b = (uint8_t)c;
+		_capture(false, &b, 1);
+	}
+	return c;
+}
+
+/**
+ * Write the data and capture the written part.
+ * @parameter	data	Data to be written
+ * @parameter	length	Length of the data
+ * @return		Written length
+ */
+template<class SerialT>
+size_t ESP8266Trace<SerialT>::write(const uint8_t *data, size_t length) {
+	length = _serial->write(data, length);
+	_capture(true, data, length);
+	return length;
+}
+
+/**
+ * Accumulate the data to the pending record.
+ * The record is written out when the direction turns, when it is full
+ * or when the received data has paused longer than ESP8266_TRACE_GAP.
+ * @parameter	tx		Direction
+ * @parameter	data	Captured data
+ * @parameter	length	Length of the data
+ */
+template<class SerialT>
+void ESP8266Trace<SerialT>::_capture(bool tx, const uint8_t *data, size_t length) {
+	uint32_t	now;
+
+	if (!_sink || !length)
+		return;
+	now = micros();
+	if (_len && (tx != _tx || (!tx && now - _byteAt > ESP8266_TRACE_GAP)))
+		_emit();
+	_byteAt = now;
+	if (tx)
+		_stat.txBytes += length;
+	else
+		_stat.rxBytes += length;
+	while (length--) {
+		if (_len >= sizeof(_rec))
+			_emit();
+		if (!_len) {
+			_tx = tx;
+			_recAt = now;
+		}
+		_rec[_len++] = *data++;
+	}
+}
+
+/**
+ * Write out the pending record.
+ */
+template<class SerialT>
+void ESP8266Trace<SerialT>::_emit(void) {
+	uint8_t		header[6];
+
+	if (!_len)
+		return;
+	header[0] = (_tx ? ESP8266_TRACE_TX : 0) | _len;
+	_put(header, _traceNumber(header + 1, _recAt - _lastAt) + 1);
+	_put(_rec, _len);
+	_lastAt = _recAt;
+	_len = 0;
+	_stat.records++;
+}
+
+/**
+ * Write to the sink and count the lost bytes.
+ * @parameter	data	Data to be written
+ * @parameter	length	Length of the data
+ */
+template<class SerialT>
+void ESP8266Trace<SerialT>::_put(const uint8_t *data, uint8_t length) {
+	_stat.lost += length - _sink->write(data, length);
+}
+
+#ifdef ESP8266_USE_TRACE
+// The driver over the capture and the replay is instantiated in ESP8266.cpp,
+// otherwise the sketch which uses them instantiates it.
+extern template class ESP8266Driver<ESP8266Trace<_ESP8266_SERIAL_TYPE>, ESP8266Policy>;
+extern template class ESP8266Driver<ESP8266Replay, ESP8266Policy>;
+#endif
+// ESP8266 class which captures the traffic
+typedef ESP8266Driver<ESP8266Trace<_ESP8266_SERIAL_TYPE> >	ESP8266Traced;
+// ESP8266 class which is driven by the trace
+typedef ESP8266Driver<ESP8266Replay>	ESP8266Replayed;
+
+#endif	/* __ESP8266TRACE_H__ */
@@ -0,0 +1,195 @@
+#include "Arduino.h"
+#include "ESP8266.h"
+// If SOFTWARSERIAL or DebugSerial is applied,
+// requires declaration of SortwareSerial.h
+#include "SoftwareSerial.h"
+SoftwareSerial	DebugSerial(8, 9);
+
+// Throughput benchmark of the ESP8266 library.
+// It measures the following on the actual link, and prints the results
+// to the DebugSerial.
+//	- Time to join the access point
+//	- Connect latency of TCP
+//	- Sending throughput with ESP8266_SEND_MAX bytes blocks
+//	- Receiving throughput of the HTTP response
+//	- Round trip time histogram of the AT command
+// Prepare a HTTP server which has a large file and a TCP sink server
+// (e.g. "nc -lk 5001 > /dev/null") on the local network.
+
+#define SSID		"WARPSTAR-9FD487-G"
+#define PWD			"BC5457B5C4E0A"
+#define HTTP_HOST	"192.168.0.10"
+#define HTTP_PORT	80
+#define HTTP_PATH	"/large.bin"
+#define SINK_HOST	"192.168.0.10"
+#define SINK_PORT	5001
+
+#define CONNECT_TRIES	10			// Number of the connect measurement
+#define SEND_BLOCKS		32			// Number of the sending blocks
+#define SEND_BLOCK_SIZE	256			// Size of the sending block in RAM
+#define RECV_IDLE		3000		// Idle time to regard as the end of receiving
+#define RTT_TRIES		100			// Number of the round trip measurement
+#define RTT_BUCKETS		16			// log2 histogram buckets of milliseconds
+
+static uint8_t	block[SEND_BLOCK_SIZE];
+static uint16_t	rttHistogram[RTT_BUCKETS];
+
+// Print the throughput with bytes per second.
+static void printRate(const __FlashStringHelper *label, uint32_t bytes, uint32_t elapsed) {
+	DebugSerial.print(label);
+	DebugSerial.print(bytes);
+	DebugSerial.print(F(" bytes in "));
+	DebugSerial.print(elapsed);
+	DebugSerial.print(F(" ms, "));
+	DebugSerial.print(elapsed ? bytes * 1000UL / elapsed : 0UL);
+	DebugSerial.println(F(" bytes/s"));
+}
+
+// Measure the connect latency to the sink server.
+static void benchConnect(void) {
+	uint32_t	startAt, elapsed, total = 0, worst = 0;
+	uint8_t		success = 0;
+
+	for (uint8_t i = 0; i < CONNECT_TRIES; i++) {
+		startAt = millis();
+		if (WiFi.connect((char *)SINK_HOST, SINK_PORT) == WIFI_ERR_CONNECT) {
+			elapsed = millis() - startAt;
+			total += elapsed;
+			if (elapsed > worst)
+				worst = elapsed;
+			success++;
+		}
+		WiFi.close();
+	}
+	DebugSerial.print(F("connect: "));
+	DebugSerial.print(success);
+	DebugSerial.print('/');
+	DebugSerial.print(CONNECT_TRIES);
+	DebugSerial.print(F(" avg "));
+	DebugSerial.print(success ? total / success : 0UL);
+	DebugSerial.print(F(" ms, max "));
+	DebugSerial.print(worst);
+	DebugSerial.println(F(" ms"));
+}
+
+// Measure the sending throughput with the gathered blocks.
+static void benchSend(void) {
+	WIFI_SEGMENT	segment[ESP8266_SEND_MAX / SEND_BLOCK_SIZE];
+	uint32_t		startAt, bytes = 0;
+	uint8_t			i;
+
+	for (i = 0; i < sizeof(segment) / sizeof(segment[0]); i++) {
+		segment[i].data = block;
+		segment[i].length = SEND_BLOCK_SIZE;
+		segment[i].progmem = false;
+	}
+	if (WiFi.connect((char *)SINK_HOST, SINK_PORT) != WIFI_ERR_CONNECT) {
+		DebugSerial.println(F("send: connect fail"));
+		return;
+	}
+	startAt = millis();
+	for (i = 0; i < SEND_BLOCKS; i++) {
+		if (WiFi.send(-1, segment, sizeof(segment) / sizeof(segment[0])) != WIFI_ERR_OK)
+			break;
+		bytes += ESP8266_SEND_MAX;
+	}
+	printRate(F("send: "), bytes, millis() - startAt);
+	WiFi.close();
+}
+
+// Measure the receiving throughput of the HTTP response.
+static void benchReceive(void) {
+	uint8_t		buffer[32];
+	uint32_t	startAt, lastAt, bytes = 0;
+	int16_t		len;
+
+	if (WiFi.connect((char *)HTTP_HOST, HTTP_PORT) != WIFI_ERR_CONNECT) {
+		DebugSerial.println(F("receive: connect fail"));
+		return;
+	}
+	if (WiFi.send((const uint8_t *)"GET " HTTP_PATH " HTTP/1.0\r\n\r\n") != WIFI_ERR_OK) {
+		DebugSerial.println(F("receive: send fail"));
+		WiFi.close();
+		return;
+	}
+	startAt = lastAt = millis();
+	while (millis() - lastAt < RECV_IDLE) {
+		if ((len = WiFi.read(-1, buffer, sizeof(buffer))) > 0) {
+			bytes += len;
+			lastAt = millis();
+		}
+	}
+	printRate(F("receive: "), bytes, lastAt - startAt);
+	WiFi.close();
+}
+
+// Measure the round trip time of the AT command.
+static void benchRoundTrip(void) {
+	uint32_t	startAt, elapsed;
+	uint8_t		bucket;
+
+	memset(rttHistogram, 0, sizeof(rttHistogram));
+	for (uint8_t i = 0; i < RTT_TRIES; i++) {
+		startAt = millis();
+		(void)WiFi.status();
+		elapsed = millis() - startAt;
+		for (bucket = 0; elapsed > 1 && bucket < RTT_BUCKETS - 1; bucket++)
+			elapsed >>= 1;
+		rttHistogram[bucket]++;
+	}
+	DebugSerial.println(F("round trip (ms): count"));
+	for (bucket = 0; bucket < RTT_BUCKETS; bucket++) {
+		if (!rttHistogram[bucket])
+			continue;
+		DebugSerial.print(F(" <"));
+		DebugSerial.print(2UL << bucket);
+		DebugSerial.print(F(": "));
+		DebugSerial.println(rttHistogram[bucket]);
+	}
+}
+
+void setup() {
+	WIFI_LINKSTAT	link;
+	uint32_t		startAt;
+
+	DebugSerial.begin(9600);
+	DebugSerial.println(F("Benchmark"));
+	if (!WiFi.reset(WIFI_RESET_HARD)) {
+		DebugSerial.println(F("reset fail"));
+		while (1);
+	}
+	if (!WiFi.autobaud()) {
+		DebugSerial.println(F("autobaud fail"));
+		while (1);
+	}
+	link = WiFi.linkStat();
+	DebugSerial.print(F("baud rate: "));
+	DebugSerial.print(link.baudrate);
+	DebugSerial.print(F(", probe errors "));
+	DebugSerial.print(link.errors);
+	DebugSerial.print('/');
+	DebugSerial.println(link.probes);
+	if (WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_SINGLE) != WIFI_ERR_OK) {
+		DebugSerial.println(F("setup fail"));
+		while (1);
+	}
+	startAt = millis();
+	if (WiFi.join(SSID, PWD) != WIFI_ERR_OK) {
+		DebugSerial.println(F("join fail"));
+		while (1);
+	}
+	DebugSerial.print(F("join: "));
+	DebugSerial.print(millis() - startAt);
+	DebugSerial.println(F(" ms"));
+	for (uint16_t i = 0; i < sizeof(block); i++)
+		block[i] = (uint8_t)i;
+}
+
+void loop() {
+	benchConnect();
+	benchSend();
+	benchReceive();
+	benchRoundTrip();
+	WiFi.disconnect();
+	while (1);
+}
@@ -1,5 +1,6 @@
 #include "Arduino.h"
 #include "ESP8266.h"
+#include "ESP8266Http.h"
 // If SOFTWARSERIAL or DebugSerial is applied,
 // requires declaration of SortwareSerial.h
 #include "SoftwareSerial.h"
@@ -8,8 +9,16 @@ SoftwareSerial	DebugSerial(8, 9);
 #define SSID	"WARPSTAR-9FD487-G"
 #define PWD		"BC5457B5C4E0A"
 
+// Print the body as it arrives.
+bool printBody(const uint8_t *data, uint16_t length) {
+	DebugSerial.write(data, length);
+	return true;
+}
+
+ESP8266Http	response(printBody);
+
 void setup() {
-	char	*ipAddress, ap[31];
+	char	*ipAddress, ap[ESP8266_SSID_SIZE];
 
 	DebugSerial.begin(9600);
 	DebugSerial.println(F("Setup"));
@@ -46,18 +55,16 @@ void setup() {
 void loop() {
 	if (WiFi.connect((char *)"www.google.co.jp", 80) == WIFI_ERR_CONNECT) {
 		DebugSerial.println(F("Send Start"));
-		if (WiFi.send((const uint8_t *)"GET / HTTP/1.1\r\n\r\n") == WIFI_ERR_OK) {
-			int16_t	c;
-			uint16_t len = WiFi.listen(10000UL);
-			DebugSerial.print(F("\nRCV:"));
-			DebugSerial.print(len);
-			DebugSerial.print(F("-->"));
-			while (len)
-				if ((c = WiFi.read()) > 0) {
-					DebugSerial.write((char)c);
-					len--;
-				}
-			DebugSerial.println(F("<--RCV"));
+		if (WiFi.send((const uint8_t *)"GET / HTTP/1.1\r\nHost: www.google.co.jp\r\n\r\n") == WIFI_ERR_OK) {
+			uint32_t	startAt = millis();
+			// The response is parsed as it arrives, the receiving ends
+			// at the end of the body by Content-Length or the chunk.
+			response.reset();
+			DebugSerial.print(F("\nRCV-->"));
+			while (!response.done() && millis() - startAt < 10000UL)
+				(void)response.parse(WiFi);
+			DebugSerial.print(F("<--RCV status:"));
+			DebugSerial.println(response.status());
 		} else {
 			DebugSerial.println(F("Send fail"));
 		}
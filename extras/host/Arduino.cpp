@@ -0,0 +1,267 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	Host stand-in of the Arduino core implementation. The virtual clock
+	advances by Host::cost() microseconds at each call to the core, and
+	the counterpart of Serial is advanced up to the clock at the same
+	time.
+*/
+
+#include <atomic>
+#include <math.h>
+#include "Arduino.h"
+
+static uint64_t		_now = 0;				// Virtual time in microseconds
+static uint32_t		_cost = 1;				// Cost of a call to the core
+static std::atomic<uint64_t>	_calls(0);	// Calls to the core
+static Host::PinHook	_pinHook = NULL;	// Handler of the pin output
+static uint8_t		_pin[64];				// Level of the pins
+static uint32_t		_seed = 1;				// Seed of random()
+static SerialPeer	*_peer = NULL;			// Counterpart of Serial
+
+HardwareSerial	Serial;
+
+/**
+ * Advance the clock and the counterpart.
+ * @parameter	us	Elapsed time
+ */
+static void _advance(uint64_t us) {
+	_calls++;
+	_now += us;
+	if (_peer)
+		_peer->service();
+}
+
+/**
+ * Time of a byte on the line, 10 bits with the start and stop bits.
+ * @parameter	baudrate	Baud rate
+ * @return		Microseconds
+ */
+static uint64_t _byteTime(uint32_t baudrate) {
+	return ((uint64_t)10000000 + baudrate / 2) / baudrate;
+}
+
+unsigned long millis(void) {
+	_advance(_cost);
+	return (unsigned long)(_now / 1000);
+}
+
+unsigned long micros(void) {
+	_advance(_cost);
+	return (unsigned long)_now;
+}
+
+void delay(unsigned long ms) {
+	_advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+	_advance(us);
+}
+
+void yield(void) {
+	_advance(_cost);
+}
+
+void pinMode(uint8_t, uint8_t) {
+	_advance(_cost);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	_advance(_cost);
+	if (pin < sizeof(_pin))
+		_pin[pin] = value;
+	if (_pinHook)
+		_pinHook(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+	_advance(_cost);
+	return pin < sizeof(_pin) ? _pin[pin] : LOW;
+}
+
+long random(long howbig) {
+	if (howbig <= 0)
+		return 0;
+	_seed = _seed * 1103515245 + 12345;
+	return (long)((_seed >> 1) % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig) {
+	return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+	_seed = (uint32_t)seed;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t	n = 0;
+
+	while (size--)
+		n += write(*buffer++);
+	return n;
+}
+
+size_t Print::print(long n, int base) {
+	if (n < 0 && base == DEC)
+		return print('-') + print((unsigned long)-n, base);
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	char	digit[24];
+	uint8_t	i = 0;
+	size_t	written = 0;
+
+	do {
+		digit[i++] = "0123456789ABCDEF"[n % base];
+		n /= base;
+	} while (n);
+	while (i)
+		written += write((uint8_t)digit[--i]);
+	return written;
+}
+
+size_t Print::print(double n, int digits) {
+	char	buffer[40];
+
+	snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+	return write(buffer);
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length) {
+	size_t			n = 0;
+	unsigned long	start = millis();
+	int				c;
+
+	while (n < length) {
+		if ((c = read()) >= 0) {
+			buffer[n++] = (uint8_t)c;
+			start = millis();
+		} else if (millis() - start >= _timeOut)
+			break;
+	}
+	return n;
+}
+
+HardwareSerial::HardwareSerial() : _baudrate(0), _head(0), _count(0), _lineFree(0), _overruns(0) {}
+
+void HardwareSerial::begin(unsigned long baudrate) {
+	_advance(_cost);
+	_baudrate = (uint32_t)baudrate;
+}
+
+void HardwareSerial::end(void) {
+	flush();
+	_baudrate = 0;
+	_count = 0;
+}
+
+int HardwareSerial::available(void) {
+	_advance(_cost);
+	return _count;
+}
+
+int HardwareSerial::read(void) {
+	uint8_t	c;
+
+	_advance(_cost);
+	if (!_count)
+		return -1;
+	c = _rx[_head];
+	_head = (uint8_t)((_head + 1) % sizeof(_rx));
+	_count--;
+	return c;
+}
+
+int HardwareSerial::peek(void) {
+	_advance(_cost);
+	return _count ? _rx[_head] : -1;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	uint64_t	byteTime;
+
+	_advance(_cost);
+	if (!_baudrate)
+		return 0;
+	byteTime = _byteTime(_baudrate);
+	if (_lineFree < _now)
+		_lineFree = _now;
+	_lineFree += byteTime;
+	// It blocks while the transmitting buffer is full.
+	if (_lineFree - _now > SERIAL_TX_BUFFER_SIZE * byteTime)
+		_advance(_lineFree - _now - SERIAL_TX_BUFFER_SIZE * byteTime);
+	if (_peer)
+		_peer->receive(_lineFree, c, _baudrate);
+	return 1;
+}
+
+void HardwareSerial::flush(void) {
+	_advance(_lineFree > _now ? _lineFree - _now : _cost);
+}
+
+void HardwareSerial::attach(SerialPeer *peer) {
+	if (this == &Serial)
+		_peer = peer;
+	clear();
+}
+
+bool HardwareSerial::arrive(uint8_t c) {
+	if (!_baudrate)
+		return true;
+	if (_count >= sizeof(_rx)) {
+		_overruns++;
+		return false;
+	}
+	_rx[(_head + _count) % sizeof(_rx)] = c;
+	_count++;
+	return true;
+}
+
+void HardwareSerial::clear(void) {
+	_head = _count = 0;
+	_lineFree = 0;
+	_overruns = 0;
+}
+
+namespace Host {
+
+uint64_t now(void) {
+	return _now;
+}
+
+void spend(uint32_t us) {
+	_advance(us);
+}
+
+void cost(uint32_t us) {
+	_cost = us;
+}
+
+uint64_t calls(void) {
+	return _calls;
+}
+
+void onPin(PinHook hook) {
+	_pinHook = hook;
+}
+
+void setPin(uint8_t pin, uint8_t value) {
+	if (pin < sizeof(_pin))
+		_pin[pin] = value;
+}
+
+void rewind(void) {
+	_now = 0;
+	_seed = 1;
+	memset(_pin, 0, sizeof(_pin));
+	Serial.clear();
+}
+
+}
@@ -0,0 +1,180 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	This is the host stand-in of the Arduino core which is just enough
+	to compile the library and the example sketches on Linux. The time
+	is virtual, it advances by the fixed cost of each call to the core
+	and by delay(), so that a run is reproducible regardless of the
+	load of the host. The serial is wired to the simulated ESP8266 of
+	EspSim.h with the timing of the baud rate.
+*/
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+// Program memory is the ordinary memory on the host.
+#define PROGMEM
+#define PSTR(s)					(s)
+typedef const char				*PGM_P;
+class __FlashStringHelper;
+#define F(s)					(reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+#define pgm_read_byte(p)		(*(const uint8_t *)(p))
+#define pgm_read_word(p)		(*(const uint16_t *)(p))
+#define pgm_read_dword(p)		(*(const uint32_t *)(p))
+#define memcpy_P				memcpy
+#define strlen_P				strlen
+#define strcmp_P				strcmp
+#define strncmp_P				strncmp
+#define strcasecmp_P			strcasecmp
+#define strstr_P				strstr
+
+typedef bool					boolean;
+typedef uint8_t					byte;
+
+#define HIGH					1
+#define LOW						0
+#define INPUT					0
+#define OUTPUT					1
+#define INPUT_PULLUP			2
+#define DEC						10
+#define HEX						16
+
+// Receiving buffer of HardwareSerial as the AVR core
+#define SERIAL_RX_BUFFER_SIZE	64
+// Transmitting buffer of HardwareSerial, write() blocks while it is full.
+#define SERIAL_TX_BUFFER_SIZE	64
+
+// Time
+unsigned long	millis(void);
+unsigned long	micros(void);
+void			delay(unsigned long ms);
+void			delayMicroseconds(unsigned int us);
+void			yield(void);
+// Digital pins
+void			pinMode(uint8_t pin, uint8_t mode);
+void			digitalWrite(uint8_t pin, uint8_t value);
+int				digitalRead(uint8_t pin);
+// Pseudo random numbers
+long			random(long howbig);
+long			random(long howsmall, long howbig);
+void			randomSeed(unsigned long seed);
+
+// Print class of the core
+class Print {
+public:
+	virtual ~Print() {}
+	virtual size_t	write(uint8_t c) = 0;
+	virtual size_t	write(const uint8_t *buffer, size_t size);
+	size_t	write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+	size_t	write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+	size_t	print(const __FlashStringHelper *s) { return write(reinterpret_cast<const char *>(s)); }
+	size_t	print(const char *s) { return write(s); }
+	size_t	print(char c) { return write((uint8_t)c); }
+	size_t	print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t	print(int n, int base = DEC) { return print((long)n, base); }
+	size_t	print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t	print(long n, int base = DEC);
+	size_t	print(unsigned long n, int base = DEC);
+	size_t	print(double n, int digits = 2);
+	size_t	println(void) { return write("\r\n"); }
+	template<class T>
+	size_t	println(T v) { size_t n = print(v); return n + println(); }
+	template<class T>
+	size_t	println(T v, int base) { size_t n = print(v, base); return n + println(); }
+};
+
+// Stream class of the core
+class Stream : public Print {
+public:
+	Stream() : _timeOut(1000) {}
+	virtual int	available(void) = 0;
+	virtual int	read(void) = 0;
+	virtual int	peek(void) = 0;
+	virtual void	flush(void) {}
+	void	setTimeout(unsigned long timeOut) { _timeOut = timeOut; }
+	size_t	readBytes(uint8_t *buffer, size_t length);
+	size_t	readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+
+protected:
+	unsigned long	_timeOut;				// Time-out of readBytes
+};
+
+// Counterpart of the serial, which is the simulated ESP8266.
+class SerialPeer {
+public:
+	virtual ~SerialPeer() {}
+	// Advance the counterpart up to the current time.
+	virtual void	service(void) = 0;
+	// A byte written by the sketch arrives at the counterpart at the time.
+	virtual void	receive(uint64_t at, uint8_t c, uint32_t baudrate) = 0;
+};
+
+// HardwareSerial class of the core
+// The transmission takes the time of 10 bits per byte, and write()
+// blocks while SERIAL_TX_BUFFER_SIZE bytes are waiting. The received
+// bytes are put into the buffer at their arrival time, and the bytes
+// arrived at the full buffer are lost as the AVR core.
+class HardwareSerial : public Stream {
+public:
+	HardwareSerial();
+	void	begin(unsigned long baudrate);
+	void	end(void);
+	int		available(void);
+	int		read(void);
+	int		peek(void);
+	using Print::write;
+	size_t	write(uint8_t c);
+	void	flush(void);
+	operator bool() { return true; }
+	// Host side of the wire
+	void	attach(SerialPeer *peer);
+	uint32_t	baudrate(void) { return _baudrate; }
+	// Put the byte arrived from the counterpart, returns false at overrun.
+	bool	arrive(uint8_t c);
+	// Bytes lost by the overrun
+	uint32_t	overruns(void) { return _overruns; }
+	void	clear(void);
+
+private:
+	uint32_t	_baudrate;					// Baud rate, 0 while ended
+	uint8_t		_rx[SERIAL_RX_BUFFER_SIZE];	// Receiving ring
+	uint8_t		_head;						// Head of the ring
+	uint8_t		_count;						// Bytes in the ring
+	uint64_t	_lineFree;					// Time the transmission line becomes free
+	uint32_t	_overruns;					// Bytes lost by the overrun
+};
+
+extern HardwareSerial	Serial;
+
+// Virtual time and the hooks of the host
+namespace Host {
+	// Current time in microseconds
+	uint64_t	now(void);
+	// Spend the time, the counterpart follows it.
+	void		spend(uint32_t us);
+	// Cost of a call to the core in microseconds
+	void		cost(uint32_t us);
+	// Calls to the core, it stops growing when the sketch halts by the endless loop.
+	uint64_t	calls(void);
+	// Handler of the pin output such as RST and RTS wired to the simulator.
+	typedef void (*PinHook)(uint8_t pin, uint8_t value);
+	void		onPin(PinHook hook);
+	// Drive the input pin such as CTS from the simulator.
+	void		setPin(uint8_t pin, uint8_t value);
+	// Rewind the clock for the next run.
+	void		rewind(void);
+}
+
+#endif	/* __HOST_ARDUINO_H__ */
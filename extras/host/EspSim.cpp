@@ -0,0 +1,997 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	Simulated ESP8266 implementation. The bytes from the sketch are
+	processed at their arrival time and the replies are put on the line
+	at the time of the event, so the timing follows the virtual clock.
+	The connections are the non-blocking loopback sockets, they are
+	polled at each advance of the clock.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "EspSim.h"
+
+EspSim	*EspSim::_pinOwner = NULL;
+
+/**
+ * Split the parameters of the command by the comma. The quoted string
+ * is unquoted and its escaped characters are restored.
+ * @parameter	args	Parameters following '='
+ * @return		Parameters
+ */
+static std::vector<std::string> _split(const std::string &args) {
+	std::vector<std::string>	list(1);
+	bool	quoted = false;
+
+	for (size_t i = 0; i < args.size(); i++) {
+		char	c = args[i];
+
+		if (quoted && c == '\\' && i + 1 < args.size())
+			list.back() += args[++i];
+		else if (c == '"')
+			quoted = !quoted;
+		else if (c == ',' && !quoted)
+			list.push_back(std::string());
+		else
+			list.back() += c;
+	}
+	return list;
+}
+
+/**
+ * Inquire whether the command line begins with the prefix.
+ */
+static bool _begins(const std::string &line, const char *prefix) {
+	return !line.compare(0, strlen(prefix), prefix);
+}
+
+/**
+ * Inquire whether the host is the IP address literal.
+ */
+static bool _literal(const std::string &host) {
+	return !host.empty() && host.find_first_not_of("0123456789.") == std::string::npos;
+}
+
+/**
+ * Make the socket non-blocking.
+ */
+static void _nonblock(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/**
+ * Loopback address of the port.
+ */
+static sockaddr_in _loopback(uint16_t port) {
+	sockaddr_in	addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	return addr;
+}
+
+EspSim::EspSim(HardwareSerial &serial) : _serial(&serial), _powered(false), _server(-1), _servicing(false) {
+	for (uint8_t i = 0; i < ESPSIM_LINKS; i++) {
+		_link[i].open = false;
+		_link[i].fd = -1;
+	}
+	_reset();
+}
+
+EspSim::~EspSim() {
+	end();
+}
+
+/**
+ * Power on the module. The boot messages and "ready" are output at the
+ * boot rate, the pins of the configuration are watched.
+ * @parameter	config	Configuration
+ */
+void EspSim::begin(const EspSimConfig &config) {
+	end();
+	_config = config;
+	memset(&_stat, 0, sizeof(_stat));
+	_noiseSeed = config.seed;
+	_trace = getenv("ESPSIM_TRACE") != NULL;
+	_clock = Host::now();
+	_lineFree = _clock;
+	_polledAt = _clock;
+	_routes.clear();
+	_aps.clear();
+	_log.clear();
+	_pollers.clear();
+	_script = nullptr;
+	_pinOwner = this;
+	Host::onPin(_pin);
+	_serial->attach(this);
+	_powered = true;
+	_reset();
+	_boot(0);
+}
+
+/**
+ * Power off the module.
+ */
+void EspSim::end(void) {
+	if (!_powered)
+		return;
+	_reset();
+	_powered = false;
+	_serial->attach(NULL);
+	if (_pinOwner == this) {
+		Host::onPin(NULL);
+		_pinOwner = NULL;
+	}
+}
+
+/**
+ * Connections to the host and the port go to the loopback port. The
+ * host name is given the private address which AT+CIPDOMAIN answers.
+ * @parameter	host		Host name or address
+ * @parameter	port		Port
+ * @parameter	localPort	Loopback port of the server
+ */
+void EspSim::route(const char *host, uint16_t port, uint16_t localPort) {
+	Route	r;
+
+	r.host = host;
+	r.port = port;
+	r.localPort = localPort;
+	if (_literal(r.host))
+		r.ip = r.host;
+	else {
+		for (size_t i = 0; i < _routes.size(); i++)
+			if (_routes[i].host == r.host)
+				r.ip = _routes[i].ip;
+		if (r.ip.empty())
+			r.ip = "10.0.0." + std::to_string(_routes.size() + 1);
+	}
+	_routes.push_back(r);
+}
+
+void EspSim::accessPoint(const EspSimAP &ap) {
+	_aps.push_back(ap);
+}
+
+void EspSim::inject(const std::string &text, uint32_t after) {
+	_at(Host::now() + after, [this, text]() { _emit(text); });
+}
+
+void EspSim::reply(const std::string &text, uint32_t after) {
+	if (after)
+		_at(_clock + after, [this, text]() { _emit(text); });
+	else
+		_emit(text);
+}
+
+/**
+ * The access point is lost, all the connections are closed.
+ * @parameter	rejoin	Rejoin by itself after joinTime
+ */
+void EspSim::drop(bool rejoin) {
+	_at(Host::now(), [this, rejoin]() {
+		if (!_joined)
+			return;
+		for (uint8_t i = 0; i < ESPSIM_LINKS; i++)
+			if (_link[i].open)
+				_close(i, true);
+		_joined = false;
+		_emit("WIFI DISCONNECT\r\n");
+		if (rejoin)
+			_at(_clock + _config.joinTime, [this]() {
+				_joined = true;
+				_emit("WIFI CONNECTED\r\nWIFI GOT IP\r\n");
+			});
+	});
+}
+
+void EspSim::hangup(uint8_t id) {
+	// Within the script, it precedes the reply of the command.
+	if (_servicing) {
+		if (linked(id))
+			_close(id, true);
+		return;
+	}
+	_at(Host::now(), [this, id]() {
+		if (linked(id))
+			_close(id, true);
+	});
+}
+
+/**
+ * Advance the module up to the current time. The bytes from the sketch
+ * and the scheduled events are processed in the order of the time.
+ */
+void EspSim::service(void) {
+	uint64_t	now = Host::now();
+	uint64_t	inAt, eventAt;
+
+	if (_servicing || !_powered)
+		return;
+	_servicing = true;
+	// The sockets are polled by the interval of the virtual time.
+	if (now - _polledAt >= ESPSIM_POLL) {
+		_polledAt = now;
+		for (size_t i = 0; i < _pollers.size(); i++)
+			_pollers[i]();
+		_clock = now;
+		_pollSockets();
+	}
+	for (;;) {
+		inAt = _in.empty() ? UINT64_MAX : _in.front().at;
+		eventAt = _events.empty() ? UINT64_MAX : _events.begin()->first;
+		if (inAt > now && eventAt > now)
+			break;
+		if (inAt <= eventAt) {
+			Byte	b = _in.front();
+
+			_in.pop_front();
+			_clock = inAt;
+			_input(b);
+		} else {
+			std::function<void(void)>	event = _events.begin()->second;
+
+			_events.erase(_events.begin());
+			_clock = eventAt;
+			event();
+		}
+	}
+	_clock = now;
+	_transmit();
+	_servicing = false;
+}
+
+/**
+ * A byte written by the sketch arrives at the time.
+ */
+void EspSim::receive(uint64_t at, uint8_t c, uint32_t baudrate) {
+	Byte	b = { at, c, baudrate };
+
+	if (_powered)
+		_in.push_back(b);
+}
+
+/**
+ * Watch RST of the module. It is held in the reset while RST is low,
+ * and it boots at the rising edge.
+ */
+void EspSim::_pin(uint8_t pin, uint8_t value) {
+	EspSim	*sim = _pinOwner;
+
+	if (!sim || pin != sim->_config.resetPin)
+		return;
+	sim->service();
+	if (value == LOW) {
+		sim->_reset();
+		sim->_booted = false;
+	} else if (!sim->_booted)
+		sim->_boot(0);
+}
+
+/**
+ * Clear the state of the firmware, the connections are lost.
+ */
+void EspSim::_reset(void) {
+	for (uint8_t i = 0; i < ESPSIM_LINKS; i++)
+		_close(i, false);
+	if (_server >= 0)
+		close(_server);
+	_server = -1;
+	_events.clear();
+	_in.clear();
+	_out.clear();
+	_booted = false;
+	_baudrate = _config.baudrate;
+	_nextBaudrate = 0;
+	_line.clear();
+	_readyAt = 0;
+	_busy = 0;
+	_echo = true;
+	_mux = 0;
+	_mode = 0;
+	_dinfo = false;
+	_passive = false;
+	_transparent = false;
+	_packet.clear();
+	_packetGen = 0;
+	_joined = false;
+	_lapMask = 0x7f;
+	_dataRemain = 0;
+}
+
+/**
+ * Boot the firmware. The messages of the boot loader are output at
+ * 74880 bps, and "ready" follows at the configured rate.
+ * @parameter	after	Delay of the boot in microseconds
+ */
+void EspSim::_boot(uint32_t after) {
+	_at(_clock + after + _config.bootTime / 3, [this]() {
+		_emit("\r\n ets Jan  8 2013,rst cause:2, boot mode:(3,6)\r\n\r\nload 0x40100000, len 1396\r\n", 74880);
+	});
+	_at(_clock + after + _config.bootTime, [this]() {
+		_booted = true;
+		_emit("\r\nready\r\n");
+	});
+}
+
+void EspSim::_at(uint64_t at, std::function<void(void)> event) {
+	_events.insert(std::make_pair(at, event));
+}
+
+/**
+ * Put the text on the output line at the time of the event.
+ * @parameter	text		Output text
+ * @parameter	baudrate	Baud rate, 0 for the current rate
+ */
+void EspSim::_emit(const std::string &text, uint32_t baudrate) {
+	if (_trace)
+		fprintf(stderr, "%10llu <%s>\n", (unsigned long long)_clock, text.c_str());
+	for (size_t i = 0; i < text.size(); i++) {
+		Byte	b = { _clock, (uint8_t)text[i], baudrate ? baudrate : _baudrate };
+
+		_out.push_back(b);
+	}
+}
+
+/**
+ * The byte is corrupted when the rates of both ends differ more than 2
+ * percent, or by the noise above the reliable rate.
+ * @parameter	c		Sent byte
+ * @parameter	from	Baud rate of the sender
+ * @parameter	to		Baud rate of the receiver
+ * @return		Received byte
+ */
+uint8_t EspSim::_corrupt(uint8_t c, uint32_t from, uint32_t to) {
+	bool	corrupt = (uint64_t)(from > to ? from - to : to - from) * 50 > from;
+
+	_noiseSeed = _noiseSeed * 1103515245 + 12345;
+	if (!corrupt && _config.reliableBaud && from > _config.reliableBaud)
+		corrupt = (_noiseSeed >> 8) % 10000 < _config.noise;
+	if (!corrupt)
+		return c;
+	_stat.corrupted++;
+	return (uint8_t)(c ^ (0x80 | (_noiseSeed >> 16)));
+}
+
+/**
+ * Process the byte from the sketch at its arrival time.
+ */
+void EspSim::_input(const Byte &b) {
+	uint8_t	c;
+
+	if (!_booted)
+		return;
+	_stat.rxBytes++;
+	c = _corrupt(b.c, b.baudrate, _baudrate);
+	// The transparent transmission forwards the packet by the interval of 20ms.
+	if (_transparent) {
+		uint32_t	gen = ++_packetGen;
+
+		_packet += (char)c;
+		_at(_clock + 20000, [this, gen]() { _flushPacket(gen); });
+		return;
+	}
+	// The data of AT+CIPSEND
+	if (_dataRemain) {
+		_data += (char)c;
+		if (!--_dataRemain)
+			_sent();
+		return;
+	}
+	if (_echo)
+		_emit(std::string(1, (char)c));
+	_line += (char)c;
+	if (_line.size() >= 2 && !_line.compare(_line.size() - 2, 2, "\r\n")) {
+		std::string	line = _line.substr(0, _line.size() - 2);
+
+		_line.clear();
+		// Garbage in front of the command is discarded.
+		size_t	at = line.find("AT");
+		if (at != std::string::npos)
+			_command(line.substr(at));
+		else if (!line.empty())
+			_error();
+	} else if (_line.size() > 512)
+		_line.clear();
+}
+
+/**
+ * Queue the command line, the commands are executed one by one after
+ * the processing time. The command arrived during the connecting or
+ * the sending is rejected by busy.
+ */
+void EspSim::_command(const std::string &line) {
+	uint64_t	at;
+
+	if (_busy) {
+		_stat.busy++;
+		_emit(_busy == 's' ? "busy s...\r\n" : "busy p...\r\n");
+		return;
+	}
+	at = (_readyAt > _clock ? _readyAt : _clock) + _config.latency;
+	_readyAt = at;
+	_at(at, [this, line]() {
+		if (_busy) {
+			_stat.busy++;
+			_emit(_busy == 's' ? "busy s...\r\n" : "busy p...\r\n");
+			return;
+		}
+		_execute(line);
+	});
+}
+
+/**
+ * Execute the command line.
+ */
+void EspSim::_execute(const std::string &line) {
+	std::string	args;
+	size_t		eq = line.find('=');
+	int			n;
+
+	_stat.commands++;
+	_log.push_back(line);
+	if (_trace)
+		fprintf(stderr, "%10llu %s\n", (unsigned long long)_clock, line.c_str());
+	if (_script && _script(*this, line))
+		return;
+	if (eq != std::string::npos)
+		args = line.substr(eq + 1);
+	if (line == "AT")
+		_ok();
+	else if (line == "ATE0" || line == "ATE1") {
+		_echo = line[3] == '1';
+		_ok();
+	} else if (line == "AT+RST") {
+		_ok();
+		_at(_clock + 20000, [this]() {
+			_reset();
+			_boot(0);
+		});
+	} else if (line == "AT+GMR")
+		_emit("AT version:0.22.0.0\r\nSDK version:1.0.0\r\n\r\nOK\r\n");
+	else if (_begins(line, "AT+UART_CUR=") || _begins(line, "AT+UART=") || _begins(line, "AT+UART_DEF=")) {
+		n = atoi(args.c_str());
+		if (n < 110 || n > 4608000)
+			_error();
+		else {
+			_ok();
+			// The new rate is effective after the reply goes out.
+			_nextBaudrate = (uint32_t)n;
+		}
+	} else if (_begins(line, "AT+CWMODE")) {
+		n = atoi(args.c_str());
+		if (n >= 1 && n <= 3)
+			_ok();
+		else
+			_error();
+	} else if (_begins(line, "AT+CIPMUX=")) {
+		bool	linked = false;
+
+		for (uint8_t i = 0; i < ESPSIM_LINKS; i++)
+			linked |= _link[i].open;
+		if (linked)
+			_emit("link is builded\r\n\r\nERROR\r\n");
+		else if (args == "0" || args == "1") {
+			_mux = (uint8_t)atoi(args.c_str());
+			_ok();
+		} else
+			_error();
+	} else if (_begins(line, "AT+CIPMODE=")) {
+		if ((args == "1" && _mux) || (args != "0" && args != "1"))
+			_error();
+		else {
+			_mode = (uint8_t)atoi(args.c_str());
+			_ok();
+		}
+	} else if (line == "AT+CWJAP?" || line == "AT+CWJAP_CUR?") {
+		if (_joined)
+			_emit("+CWJAP:\"" + _ssid + "\",\"aa:bb:cc:dd:ee:ff\",6,-52\r\n\r\nOK\r\n");
+		else
+			_emit("No AP\r\n\r\nOK\r\n");
+	} else if (_begins(line, "AT+CWJAP"))
+		_join(args);
+	else if (line == "AT+CWQAP") {
+		_ok();
+		drop(false);
+	} else if (_begins(line, "AT+CWLAPOPT=")) {
+		std::vector<std::string>	p = _split(args);
+
+		_lapMask = p.size() > 1 ? (uint8_t)atoi(p[1].c_str()) : 0x7f;
+		_ok();
+	} else if (_begins(line, "AT+CWLAP"))
+		_scan();
+	else if (line == "AT+CIFSR")
+		_emit(std::string("+CIFSR:STAIP,\"") + (_joined ? "192.168.0.20" : "0.0.0.0")
+			+ "\"\r\n+CIFSR:STAMAC,\"18:fe:34:00:00:01\"\r\n\r\nOK\r\n");
+	else if (line == "AT+CIPSTATUS")
+		_status();
+	else if (_begins(line, "AT+CIPDOMAIN=")) {
+		std::string	host = _split(args)[0];
+		std::string	ip;
+
+		for (size_t i = 0; i < _routes.size(); i++)
+			if (_routes[i].host == host || _routes[i].ip == host)
+				ip = _routes[i].ip;
+		_busy = 'p';
+		_at(_clock + _config.netLatency, [this, ip]() {
+			_busy = 0;
+			if (ip.empty())
+				_emit("DNS Fail\r\n\r\nERROR\r\n");
+			else
+				_emit("+CIPDOMAIN:" + ip + "\r\n\r\nOK\r\n");
+		});
+	} else if (_begins(line, "AT+CIPSTART="))
+		_start(args);
+	else if (_begins(line, "AT+CIPSEND"))
+		_send(args);
+	else if (_begins(line, "AT+CIPCLOSE")) {
+		n = eq == std::string::npos ? 0 : atoi(args.c_str());
+		if (n == ESPSIM_LINKS) {
+			for (uint8_t i = 0; i < ESPSIM_LINKS; i++)
+				if (_link[i].open)
+					_close(i, true);
+			_ok();
+		} else if (n < 0 || n >= ESPSIM_LINKS || !_link[n].open)
+			_emit("UNLINK\r\n\r\nERROR\r\n");
+		else {
+			_close((uint8_t)n, true);
+			_ok();
+		}
+	} else if (_begins(line, "AT+CIPSERVER=")) {
+		std::vector<std::string>	p = _split(args);
+
+		if (p[0] == "0") {
+			if (_server >= 0)
+				close(_server);
+			_server = -1;
+			_ok();
+		} else if (!_mux)
+			_error();
+		else {
+			sockaddr_in	addr = _loopback(p.size() > 1 ? (uint16_t)atoi(p[1].c_str()) : 333);
+			int			on = 1;
+
+			if (_server >= 0)
+				close(_server);
+			_server = socket(AF_INET, SOCK_STREAM, 0);
+			setsockopt(_server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			if (bind(_server, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(_server, 4) < 0) {
+				close(_server);
+				_server = -1;
+				_error();
+			} else {
+				_nonblock(_server);
+				_ok();
+			}
+		}
+	} else if (_begins(line, "AT+CIPSTO="))
+		_ok();
+	else if (_begins(line, "AT+CIPDINFO=")) {
+		_dinfo = args == "1";
+		_ok();
+	} else if (_begins(line, "AT+CIPRECVMODE=")) {
+		_passive = args == "1";
+		_ok();
+	} else if (_begins(line, "AT+CIPRECVDATA="))
+		_recvData(args);
+	else
+		_error();
+}
+
+/**
+ * AT+CWJAP="<ssid>","<pwd>"[,"<bssid>"]
+ */
+void EspSim::_join(const std::string &args) {
+	std::string	ssid = _split(args)[0];
+
+	if (_joined) {
+		for (uint8_t i = 0; i < ESPSIM_LINKS; i++)
+			if (_link[i].open)
+				_close(i, true);
+		_joined = false;
+		_emit("WIFI DISCONNECT\r\n");
+	}
+	_busy = 'p';
+	if (_config.ssid && ssid != _config.ssid) {
+		_at(_clock + _config.joinTime, [this]() {
+			_busy = 0;
+			_emit("+CWJAP:3\r\n\r\nFAIL\r\n");
+		});
+		return;
+	}
+	_at(_clock + _config.joinTime / 2, [this]() { _emit("WIFI CONNECTED\r\n"); });
+	_at(_clock + _config.joinTime, [this, ssid]() {
+		_busy = 0;
+		_joined = true;
+		_ssid = ssid;
+		_emit("WIFI GOT IP\r\n\r\nOK\r\n");
+	});
+}
+
+/**
+ * AT+CWLAP[="<ssid>"], the fields are selected by AT+CWLAPOPT.
+ */
+void EspSim::_scan(void) {
+	_busy = 'p';
+	_at(_clock + 1000000, [this]() {
+		std::string	text;
+
+		_busy = 0;
+		for (size_t i = 0; i < _aps.size(); i++) {
+			const EspSimAP	&ap = _aps[i];
+			std::string		field[5] = {
+				std::to_string(ap.ecn), "\"" + ap.ssid + "\"", std::to_string(ap.rssi),
+				"\"" + ap.mac + "\"", std::to_string(ap.channel)
+			};
+			std::string		entry;
+
+			for (uint8_t f = 0; f < 5; f++)
+				if (_lapMask & (1 << f))
+					entry += (entry.empty() ? "" : ",") + field[f];
+			text += "+CWLAP:(" + entry + ")\r\n";
+		}
+		_emit(text + "\r\nOK\r\n");
+	});
+}
+
+/**
+ * AT+CIPSTART=[<id>,]"<type>","<host>",<port>[,<local port>,<mode>]
+ */
+void EspSim::_start(const std::string &args) {
+	std::vector<std::string>	p = _split(args);
+	const Route	*route;
+	uint8_t		id = 0;
+	int			fd;
+	sockaddr_in	addr;
+
+	if (_mux) {
+		id = (uint8_t)atoi(p[0].c_str());
+		p.erase(p.begin());
+	}
+	if (p.size() < 3 || id >= ESPSIM_LINKS || (p[0] != "TCP" && p[0] != "UDP")) {
+		_error();
+		return;
+	}
+	if (_link[id].open) {
+		_emit("ALREADY CONNECTED\r\n\r\nERROR\r\n");
+		return;
+	}
+	if (!_joined) {
+		_emit("no ip\r\n\r\nERROR\r\n");
+		return;
+	}
+	_busy = 'p';
+	route = _route(p[1], (uint16_t)atoi(p[2].c_str()));
+	fd = socket(AF_INET, p[0] == "TCP" ? SOCK_STREAM : SOCK_DGRAM, 0);
+	addr = _loopback(route ? route->localPort : 0);
+	// The datagram needs no route until it is sent, such as "0.0.0.0" to any peer.
+	if (p[0] == "TCP" && (!route || connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)) {
+		close(fd);
+		_at(_clock + _config.netLatency, [this]() {
+			_busy = 0;
+			_emit(_mux ? "\r\nERROR\r\n" : "CLOSED\r\n\r\nERROR\r\n");
+		});
+		return;
+	}
+	if (p[0] == "UDP") {
+		sockaddr_in	local = _loopback(0);
+
+		bind(fd, (sockaddr *)&local, sizeof(local));
+	} else {
+		int	on = 1;
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	_nonblock(fd);
+	_link[id].open = true;
+	_link[id].udp = p[0] == "UDP";
+	_link[id].fd = fd;
+	_link[id].ip = route ? route->ip : p[1];
+	_link[id].port = route ? route->port : (uint16_t)atoi(p[2].c_str());
+	_link[id].pending.clear();
+	_stat.connects++;
+	_at(_clock + _config.netLatency, [this, id]() {
+		_busy = 0;
+		_emit(_prefix(id) + "CONNECT\r\n\r\nOK\r\n");
+	});
+}
+
+/**
+ * AT+CIPSEND=[<id>,]<length>[,"<ip>",<port>], or AT+CIPSEND for the
+ * transparent transmission.
+ */
+void EspSim::_send(const std::string &args) {
+	std::vector<std::string>	p = _split(args);
+	uint8_t		id = 0;
+	int			length;
+
+	if (args.empty()) {
+		if (_mode != 1 || _mux || !_link[0].open) {
+			_error();
+			return;
+		}
+		_transparent = true;
+		_packet.clear();
+		_emit("\r\nOK\r\n\r\n>");
+		return;
+	}
+	if (_mux) {
+		id = (uint8_t)atoi(p[0].c_str());
+		p.erase(p.begin());
+	}
+	length = p.empty() ? 0 : atoi(p[0].c_str());
+	if (id >= ESPSIM_LINKS || !_link[id].open) {
+		_emit("link is not valid\r\n\r\nERROR\r\n");
+		return;
+	}
+	if (length <= 0 || length > 2048) {
+		_error();
+		return;
+	}
+	_dataLink = id;
+	_dataHost = p.size() > 2 ? p[1] : std::string();
+	_dataPort = p.size() > 2 ? (uint16_t)atoi(p[2].c_str()) : 0;
+	_data.clear();
+	_dataRemain = (uint16_t)length;
+	_emit("\r\nOK\r\n> ");
+}
+
+/**
+ * The data of AT+CIPSEND has been received, it is forwarded to the
+ * remote end and SEND OK follows by the round trip.
+ */
+void EspSim::_sent(void) {
+	Link		&link = _link[_dataLink];
+	uint8_t		id = _dataLink;
+	bool		ok = link.open;
+
+	_emit("\r\nRecv " + std::to_string(_data.size()) + " bytes\r\n");
+	if (ok && link.udp) {
+		const Route	*route = _route(_dataHost.empty() ? link.ip : _dataHost, _dataHost.empty() ? link.port : _dataPort);
+		sockaddr_in	addr = _loopback(route ? route->localPort : 0);
+
+		if (route)
+			(void)sendto(link.fd, _data.data(), _data.size(), 0, (sockaddr *)&addr, sizeof(addr));
+	} else if (ok)
+		ok = ::send(link.fd, _data.data(), _data.size(), MSG_NOSIGNAL) == (ssize_t)_data.size();
+	_busy = 's';
+	_at(_clock + _config.netLatency, [this, ok, id]() {
+		_busy = 0;
+		_emit(ok && _link[id].open ? "\r\nSEND OK\r\n" : "\r\nSEND FAIL\r\n");
+	});
+}
+
+/**
+ * Close the connection.
+ * @parameter	id		Connection ID
+ * @parameter	notify	Output "[<id>,]CLOSED"
+ */
+void EspSim::_close(uint8_t id, bool notify) {
+	Link	&link = _link[id];
+
+	if (link.fd >= 0)
+		close(link.fd);
+	link.fd = -1;
+	if (!link.open)
+		return;
+	link.open = false;
+	link.pending.clear();
+	if (notify)
+		_emit(_prefix(id) + "CLOSED\r\n");
+}
+
+/**
+ * AT+CIPRECVDATA=[<id>,]<length> in the passive mode
+ */
+void EspSim::_recvData(const std::string &args) {
+	std::vector<std::string>	p = _split(args);
+	uint8_t		id = 0;
+	size_t		length;
+	std::string	data;
+
+	if (_mux) {
+		id = (uint8_t)atoi(p[0].c_str());
+		p.erase(p.begin());
+	}
+	if (!_passive || p.empty() || id >= ESPSIM_LINKS) {
+		_error();
+		return;
+	}
+	length = (size_t)atoi(p[0].c_str());
+	data = _link[id].pending.substr(0, length);
+	_link[id].pending.erase(0, data.size());
+	_emit("+CIPRECVDATA," + std::to_string(data.size()) + ":" + data + "\r\n\r\nOK\r\n");
+}
+
+/**
+ * AT+CIPSTATUS
+ */
+void EspSim::_status(void) {
+	std::string	text;
+	bool		linked = false;
+
+	for (uint8_t i = 0; i < ESPSIM_LINKS; i++)
+		if (_link[i].open) {
+			linked = true;
+			text += "+CIPSTATUS:" + std::to_string(i) + ",\"" + (_link[i].udp ? "UDP" : "TCP") + "\",\""
+				+ _link[i].ip + "\"," + std::to_string(_link[i].port) + ",4096,0\r\n";
+		}
+	_emit(std::string("STATUS:") + (!_joined ? "5" : linked ? "3" : "2") + "\r\n" + text + "\r\nOK\r\n");
+}
+
+/**
+ * The packet of the transparent transmission ends by the interval,
+ * "+++" alone escapes from the transmission.
+ */
+void EspSim::_flushPacket(uint32_t gen) {
+	if (gen != _packetGen || _packet.empty())
+		return;
+	if (_packet == "+++")
+		_transparent = false;
+	else if (_link[0].open && !_link[0].udp)
+		(void)::send(_link[0].fd, _packet.data(), _packet.size(), MSG_NOSIGNAL);
+	_packet.clear();
+}
+
+/**
+ * Poll the loopback sockets, the arrived data is output after the
+ * round trip time.
+ */
+void EspSim::_pollSockets(void) {
+	char		buffer[ESPSIM_MSS];
+	ssize_t		n;
+	int			fd;
+	uint8_t		id;
+
+	if (!_booted)
+		return;
+	// Connection to the server
+	if (_server >= 0 && (fd = accept(_server, NULL, NULL)) >= 0) {
+		for (id = 0; id < ESPSIM_LINKS && _link[id].open; id++)
+			;
+		if (id >= ESPSIM_LINKS)
+			close(fd);
+		else {
+			_nonblock(fd);
+			_link[id].open = true;
+			_link[id].udp = false;
+			_link[id].fd = fd;
+			_link[id].ip = "192.168.0.30";
+			_link[id].port = 50000 + id;
+			_link[id].pending.clear();
+			_stat.connects++;
+			_emit(_prefix(id) + "CONNECT\r\n");
+		}
+	}
+	for (id = 0; id < ESPSIM_LINKS; id++) {
+		Link	&link = _link[id];
+
+		if (!link.open || link.fd < 0)
+			continue;
+		if (link.udp) {
+			sockaddr_in	from;
+			socklen_t	len = sizeof(from);
+			std::string	ip = link.ip;
+			uint16_t	port = link.port;
+
+			while ((n = recvfrom(link.fd, buffer, sizeof(buffer), 0, (sockaddr *)&from, &len)) > 0) {
+				// The remote end is reported by the route of the sender.
+				for (size_t i = 0; i < _routes.size(); i++)
+					if (_routes[i].localPort == ntohs(from.sin_port)) {
+						ip = _routes[i].ip;
+						port = _routes[i].port;
+					}
+				_arrive(id, std::string(buffer, (size_t)n), ip, port);
+				len = sizeof(from);
+			}
+			continue;
+		}
+		while ((n = recv(link.fd, buffer, sizeof(buffer), 0)) > 0)
+			_arrive(id, std::string(buffer, (size_t)n), link.ip, link.port);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			// Closed by the remote end
+			close(link.fd);
+			link.fd = -1;
+			_at(_clock + _config.netLatency, [this, id]() {
+				if (_link[id].open)
+					_close(id, true);
+			});
+		}
+	}
+}
+
+/**
+ * The data arrives at the connection after the round trip time. It is
+ * output by +IPD, or held until AT+CIPRECVDATA in the passive mode.
+ */
+void EspSim::_arrive(uint8_t id, const std::string &data, const std::string &ip, uint16_t port) {
+	_at(_clock + _config.netLatency, [this, id, data, ip, port]() {
+		Link		&link = _link[id];
+		std::string	head = "\r\n+IPD,";
+
+		if (!link.open)
+			return;
+		if (_transparent) {
+			_emit(data);
+			return;
+		}
+		if (_mux)
+			head += std::to_string(id) + ",";
+		if (_passive) {
+			link.pending += data;
+			_emit(head + std::to_string(link.pending.size()) + "\r\n");
+			return;
+		}
+		head += std::to_string(data.size());
+		if (_dinfo)
+			head += "," + ip + "," + std::to_string(port);
+		_emit(head + ":" + data);
+	});
+}
+
+/**
+ * Put the output bytes on the line up to the current time. The line
+ * stops while the sketch holds CTS of the module, and the new baud rate
+ * is effective after the output drains.
+ */
+void EspSim::_transmit(void) {
+	uint64_t	start, arrival;
+
+	while (!_out.empty()) {
+		Byte	&b = _out.front();
+
+		start = b.at > _lineFree ? b.at : _lineFree;
+		if (_config.rtsPin >= 0 && digitalRead((uint8_t)_config.rtsPin) == HIGH && start <= _clock) {
+			_lineFree = _clock;
+			break;
+		}
+		arrival = start + ((uint64_t)10000000 + b.baudrate / 2) / b.baudrate;
+		if (arrival > _clock)
+			break;
+		_stat.txBytes++;
+		if (_serial->baudrate())
+			(void)_serial->arrive(_corrupt(b.c, b.baudrate, _serial->baudrate()));
+		_lineFree = arrival;
+		_out.pop_front();
+	}
+	if (_out.empty() && _nextBaudrate) {
+		_baudrate = _nextBaudrate;
+		_nextBaudrate = 0;
+	}
+}
+
+/**
+ * Find the route of the remote end, the loopback address goes to the
+ * port as it is.
+ */
+const EspSim::Route *EspSim::_route(const std::string &host, uint16_t port) {
+	static Route	loopback;
+
+	for (size_t i = 0; i < _routes.size(); i++)
+		if ((_routes[i].host == host || _routes[i].ip == host) && _routes[i].port == port)
+			return &_routes[i];
+	if (host != "127.0.0.1")
+		return NULL;
+	loopback.host = loopback.ip = host;
+	loopback.port = loopback.localPort = port;
+	return &loopback;
+}
+
+/**
+ * Prefix of the connection ID in the multiple connection.
+ */
+std::string EspSim::_prefix(uint8_t id) {
+	return _mux ? std::to_string(id) + "," : std::string();
+}
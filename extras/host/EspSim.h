@@ -0,0 +1,206 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	This is the #include header of the simulated ESP8266 for the host
+	build. It stands at the other end of Serial and speaks the AT
+	command set of the firmware 0.22 and later which the library uses,
+	with the timing of the baud rate, the processing latency and the
+	noise of the line. The connections are carried by the loopback
+	sockets, so that the sketch talks to the servers on the host.
+*/
+
+#ifndef __ESPSIM_H__
+#define __ESPSIM_H__
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+// Number of the connections of ESP8266
+#define ESPSIM_LINKS		5
+// Segment size of +IPD
+#define ESPSIM_MSS			1460
+// Interval to poll the loopback sockets in microseconds
+#define ESPSIM_POLL			100
+
+// Configuration of the simulated module
+struct EspSimConfig {
+	uint32_t	baudrate = 115200;			// Baud rate at the boot
+	uint32_t	reliableBaud = 0;			// The noise is applied above it, 0 without the noise
+	uint16_t	noise = 0;					// Corrupted bytes per 10000 above reliableBaud
+	uint32_t	latency = 2000;				// Processing time of a command in microseconds
+	uint32_t	netLatency = 4000;			// Round trip time of the network in microseconds
+	uint32_t	joinTime = 1500000;			// Time to join the access point in microseconds
+	uint32_t	bootTime = 300000;			// Time from the reset to "ready" in microseconds
+	int8_t		resetPin = 2;				// Arduino pin wired to RST, -1 not wired
+	int8_t		rtsPin = -1;				// Arduino pin wired to CTS of ESP8266, -1 not wired
+	int8_t		ctsPin = -1;				// Arduino pin wired to RTS of ESP8266, -1 not wired
+	const char	*ssid = NULL;				// Access point to be joined, NULL for any
+	uint32_t	seed = 1;					// Seed of the noise
+};
+
+// Statistics of the simulated module
+struct EspSimStat {
+	uint32_t	commands;					// Executed commands
+	uint32_t	busy;						// Commands rejected by busy
+	uint32_t	rxBytes;					// Bytes received from the sketch
+	uint32_t	txBytes;					// Bytes transmitted to the sketch
+	uint32_t	corrupted;					// Bytes corrupted by the baud mismatch or the noise
+	uint32_t	connects;					// Established connections
+};
+
+// Access point reported by AT+CWLAP
+struct EspSimAP {
+	uint8_t		ecn;						// Encryption
+	std::string	ssid;						// SSID
+	int8_t		rssi;						// Signal strength
+	std::string	mac;						// BSSID
+	uint8_t		channel;					// Channel
+};
+
+// EspSim class declaration
+class EspSim : public SerialPeer {
+
+public:
+	// Handler of the command, returns true when it replied by itself.
+	typedef std::function<bool(EspSim &sim, const std::string &line)>	Script;
+
+	EspSim(HardwareSerial &serial = Serial);
+	~EspSim();
+	// Power on the module with the configuration, it boots up to "ready".
+	void		begin(const EspSimConfig &config = EspSimConfig());
+	// Power off the module.
+	void		end(void);
+	// Connections to the host and the port go to the loopback port.
+	void		route(const char *host, uint16_t port, uint16_t localPort);
+	// Add the access point found by AT+CWLAP.
+	void		accessPoint(const EspSimAP &ap);
+	// Output the unsolicited text after the delay in microseconds.
+	void		inject(const std::string &text, uint32_t after = 0);
+	// Output the reply of the command handled by the script.
+	void		reply(const std::string &text, uint32_t after = 0);
+	// The access point is lost, it rejoins by itself after joinTime if rejoin.
+	void		drop(bool rejoin = false);
+	// Close the connection from the remote end, at once within the script.
+	void		hangup(uint8_t id);
+	// Set the handler of the command.
+	void		script(Script handler) { _script = handler; }
+	// Add the function which is polled along with the module such as a server.
+	void		poll(std::function<void(void)> poller) { _pollers.push_back(poller); }
+	// Executed command lines
+	const std::vector<std::string>	&commands(void) { return _log; }
+	// Inquire the connection is established.
+	bool		linked(uint8_t id) { return id < ESPSIM_LINKS && _link[id].open; }
+	// Station has joined.
+	bool		joined(void) { return _joined; }
+	// Current baud rate of the module
+	uint32_t	baudrate(void) { return _baudrate; }
+	EspSimStat	stat(void) { return _stat; }
+	// SerialPeer
+	void		service(void);
+	void		receive(uint64_t at, uint8_t c, uint32_t baudrate);
+
+private:
+	// Connection of the module
+	struct Link {
+		bool		open;					// Established
+		bool		udp;					// UDP
+		int			fd;						// Loopback socket
+		std::string	ip;						// Remote address
+		uint16_t	port;					// Remote port
+		std::string	pending;				// Data held in the passive mode
+	};
+	// Byte on the line
+	struct Byte {
+		uint64_t	at;						// Arrival or ready time
+		uint8_t		c;						// Data
+		uint32_t	baudrate;				// Baud rate of the sender
+	};
+	// Route of the remote end
+	struct Route {
+		std::string	host;					// Host name or address
+		std::string	ip;						// Address
+		uint16_t	port;					// Port
+		uint16_t	localPort;				// Loopback port
+	};
+
+	HardwareSerial	*_serial;				// Serial of the sketch
+	EspSimConfig	_config;				// Configuration
+	EspSimStat		_stat;					// Statistics
+	bool			_powered;				// Powered on
+	bool			_booted;				// Accepts the commands
+	uint64_t		_clock;					// Time of the event in process
+	uint64_t		_polledAt;				// Time the sockets were polled
+	std::multimap<uint64_t, std::function<void(void)> >	_events;	// Scheduled events
+	std::deque<Byte>	_in;				// Bytes from the sketch
+	std::deque<Byte>	_out;				// Bytes to the sketch
+	uint64_t		_lineFree;				// Time the output line becomes free
+	uint32_t		_baudrate;				// Current baud rate
+	uint32_t		_nextBaudrate;			// Baud rate after the output drains
+	uint32_t		_noiseSeed;				// Pseudo random sequence of the noise
+	std::string		_line;					// Command line being received
+	uint64_t		_readyAt;				// Time the preceding command finishes
+	char			_busy;					// 'p' or 's' while the command is in progress
+	bool			_echo;					// ATE1
+	uint8_t			_mux;					// AT+CIPMUX
+	uint8_t			_mode;					// AT+CIPMODE
+	bool			_dinfo;					// AT+CIPDINFO
+	bool			_passive;				// AT+CIPRECVMODE
+	bool			_transparent;			// In the transparent transmission
+	std::string		_packet;				// Data of the transparent transmission
+	uint32_t		_packetGen;				// Generation of the packet timer
+	bool			_joined;				// Station has joined
+	std::string		_ssid;					// Joined access point
+	uint8_t			_lapMask;				// AT+CWLAPOPT mask
+	int				_server;				// Listening socket, -1 if not serving
+	uint16_t		_dataRemain;			// Remaining data of AT+CIPSEND
+	uint8_t			_dataLink;				// Connection of AT+CIPSEND
+	std::string		_data;					// Data of AT+CIPSEND
+	std::string		_dataHost;				// Destination of the datagram
+	uint16_t		_dataPort;				// Destination port of the datagram
+	Link			_link[ESPSIM_LINKS];	// Connections
+	std::vector<Route>	_routes;			// Routes
+	std::vector<EspSimAP>	_aps;			// Access points
+	std::vector<std::string>	_log;		// Executed commands
+	std::vector<std::function<void(void)> >	_pollers;	// Polled functions
+	Script			_script;				// Handler of the command
+	bool			_servicing;				// Guard of the reentrance
+	bool			_trace;					// Trace to stderr by ESPSIM_TRACE
+
+	static EspSim	*_pinOwner;				// Instance which watches the pins
+	static void		_pin(uint8_t pin, uint8_t value);
+
+	void		_reset(void);
+	void		_boot(uint32_t after);
+	void		_at(uint64_t at, std::function<void(void)> event);
+	void		_emit(const std::string &text, uint32_t baudrate = 0);
+	void		_ok(void) { _emit("\r\nOK\r\n"); }
+	void		_error(void) { _emit("\r\nERROR\r\n"); }
+	uint8_t		_corrupt(uint8_t c, uint32_t from, uint32_t to);
+	void		_input(const Byte &b);
+	void		_command(const std::string &line);
+	void		_execute(const std::string &line);
+	void		_join(const std::string &args);
+	void		_scan(void);
+	void		_start(const std::string &args);
+	void		_send(const std::string &args);
+	void		_sent(void);
+	void		_close(uint8_t id, bool notify);
+	void		_recvData(const std::string &args);
+	void		_status(void);
+	void		_flushPacket(uint32_t gen);
+	void		_pollSockets(void);
+	void		_arrive(uint8_t id, const std::string &data, const std::string &ip, uint16_t port);
+	void		_transmit(void);
+	const Route	*_route(const std::string &host, uint16_t port);
+	std::string	_prefix(uint8_t id);
+};
+
+#endif	/* __ESPSIM_H__ */
@@ -0,0 +1,141 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	Loopback servers implementation.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "Loopback.h"
+
+LoopbackServer::LoopbackServer(bool udp) : _udp(udp), _port(0), _received(0) {
+	sockaddr_in	addr;
+	socklen_t	len = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	_fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+	if (_fd < 0 || bind(_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || (!udp && listen(_fd, 8) < 0)) {
+		perror("loopback");
+		return;
+	}
+	fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+	getsockname(_fd, (sockaddr *)&addr, &len);
+	_port = ntohs(addr.sin_port);
+}
+
+LoopbackServer::~LoopbackServer() {
+	for (size_t i = 0; i < _conns.size(); i++)
+		close(_conns[i].fd);
+	if (_fd >= 0)
+		close(_fd);
+}
+
+void LoopbackServer::poll(void) {
+	char		buffer[2048];
+	ssize_t		n;
+	int			fd;
+
+	if (_fd < 0)
+		return;
+	if (_udp) {
+		sockaddr_in	from;
+		socklen_t	len = sizeof(from);
+		std::string	reply;
+
+		while ((n = recvfrom(_fd, buffer, sizeof(buffer), 0, (sockaddr *)&from, &len)) > 0) {
+			_received += n;
+			reply = datagram(std::string(buffer, (size_t)n));
+			if (!reply.empty())
+				(void)sendto(_fd, reply.data(), reply.size(), 0, (sockaddr *)&from, len);
+			len = sizeof(from);
+		}
+		return;
+	}
+	while ((fd = accept(_fd, NULL, NULL)) >= 0) {
+		Conn	conn;
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		conn.fd = fd;
+		conn.closing = false;
+		_conns.push_back(conn);
+	}
+	for (size_t i = 0; i < _conns.size(); ) {
+		Conn	&conn = _conns[i];
+		bool	gone = false;
+
+		while ((n = recv(conn.fd, buffer, sizeof(buffer), 0)) > 0) {
+			_received += n;
+			conn.in.append(buffer, (size_t)n);
+		}
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+			gone = true;
+		if (!conn.in.empty())
+			data(conn);
+		while (!conn.out.empty() && (n = send(conn.fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL)) > 0)
+			conn.out.erase(0, (size_t)n);
+		if (gone || (conn.closing && conn.out.empty())) {
+			close(conn.fd);
+			_conns.erase(_conns.begin() + i);
+		} else
+			i++;
+	}
+}
+
+void LoopbackHttp::content(const std::string &path, size_t size) {
+	std::string	body(size, ' ');
+
+	for (size_t i = 0; i < size; i++)
+		body[i] = (char)('0' + i % 64);
+	_content[path] = body;
+}
+
+/**
+ * Answer the GET request which has arrived entirely. The connection is
+ * closed after the response unless the request is HTTP/1.1 without
+ * "Connection: close".
+ */
+void LoopbackHttp::data(Conn &conn) {
+	size_t		end, sp;
+	std::string	request, path, body, status = "200 OK";
+	bool		keep;
+	std::map<std::string, std::string>::iterator	it;
+	char		size[16];
+
+	while ((end = conn.in.find("\r\n\r\n")) != std::string::npos) {
+		request = conn.in.substr(0, end);
+		conn.in.erase(0, end + 4);
+		sp = request.find(' ');
+		path = sp == std::string::npos ? "" : request.substr(sp + 1, request.find(' ', sp + 1) - sp - 1);
+		keep = request.find("HTTP/1.1") != std::string::npos && request.find("Connection: close") == std::string::npos;
+		if ((it = _content.find(path)) != _content.end())
+			body = it->second;
+		else {
+			status = "404 Not Found";
+			body = "Not Found\r\n";
+		}
+		conn.out += "HTTP/1.1 " + status + "\r\nContent-Type: text/plain\r\n";
+		if (_chunked) {
+			conn.out += "Transfer-Encoding: chunked\r\n\r\n";
+			for (size_t i = 0; i < body.size(); i += 1000) {
+				snprintf(size, sizeof(size), "%zx\r\n", body.size() - i < 1000 ? body.size() - i : (size_t)1000);
+				conn.out += size + body.substr(i, 1000) + "\r\n";
+			}
+			conn.out += "0\r\n\r\n";
+		} else
+			conn.out += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+		if (!keep)
+			conn.closing = true;
+	}
+}
@@ -0,0 +1,90 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	This is the #include header of the servers on the loopback interface
+	which the simulated ESP8266 connects to. They are non-blocking and
+	polled along with the simulator, so no thread is involved.
+*/
+
+#ifndef __LOOPBACK_H__
+#define __LOOPBACK_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// LoopbackServer class declaration
+// The base of the servers, it accepts the connections on the ephemeral
+// port of 127.0.0.1 and keeps the received and the sending data of each.
+class LoopbackServer {
+
+public:
+	// Connection to the server
+	struct Conn {
+		int			fd;						// Socket
+		std::string	in;						// Received data not consumed
+		std::string	out;					// Data waiting for the sending
+		bool		closing;				// Close after the sending
+	};
+
+	LoopbackServer(bool udp = false);
+	virtual ~LoopbackServer();
+	// Port of the server
+	uint16_t	port(void) { return _port; }
+	// Accept, receive and send without blocking.
+	void		poll(void);
+	// Received bytes
+	uint64_t	received(void) { return _received; }
+
+protected:
+	// The data has arrived at the connection.
+	virtual void	data(Conn &conn) = 0;
+	// The datagram has arrived, the reply goes back to the sender.
+	virtual std::string	datagram(const std::string &data) { return std::string(); }
+
+private:
+	int			_fd;						// Listening or datagram socket
+	bool		_udp;						// Datagram server
+	uint16_t	_port;						// Port
+	uint64_t	_received;					// Received bytes
+	std::vector<Conn>	_conns;				// Connections
+};
+
+// Sink which discards the data.
+class LoopbackSink : public LoopbackServer {
+protected:
+	void	data(Conn &conn) { conn.in.clear(); }
+};
+
+// Echo of the stream or the datagram.
+class LoopbackEcho : public LoopbackServer {
+public:
+	LoopbackEcho(bool udp = false) : LoopbackServer(udp) {}
+protected:
+	void	data(Conn &conn) { conn.out += conn.in; conn.in.clear(); }
+	std::string	datagram(const std::string &data) { return data; }
+};
+
+// HTTP/1.1 server which answers GET with the registered content.
+class LoopbackHttp : public LoopbackServer {
+public:
+	// Register the content of the path.
+	void	content(const std::string &path, const std::string &body) { _content[path] = body; }
+	// Register the content of the size which has the repeated pattern.
+	void	content(const std::string &path, size_t size);
+	// Answer by the chunked transfer coding.
+	void	chunked(bool chunked) { _chunked = chunked; }
+	LoopbackHttp() : _chunked(false) {}
+protected:
+	void	data(Conn &conn);
+private:
+	std::map<std::string, std::string>	_content;	// Contents by the path
+	bool	_chunked;						// Chunked transfer coding
+};
+
+#endif	/* __LOOPBACK_H__ */
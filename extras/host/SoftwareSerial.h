@@ -0,0 +1,39 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	Host stand-in of SoftwareSerial. It is the console of the sketch
+	such as DebugSerial, the written data goes to the standard output
+	and nothing is received.
+*/
+
+#ifndef __HOST_SOFTWARESERIAL_H__
+#define __HOST_SOFTWARESERIAL_H__
+
+#include "Arduino.h"
+
+// Capacity of the receiving buffer
+#define _SS_MAX_RX_BUFF		64
+
+class SoftwareSerial : public Stream {
+public:
+	SoftwareSerial(uint8_t, uint8_t, bool = false) {}
+	void	begin(long) {}
+	void	end(void) {}
+	bool	listen(void) { return true; }
+	bool	isListening(void) { return true; }
+	bool	overflow(void) { return false; }
+	int		available(void) { return 0; }
+	int		read(void) { return -1; }
+	int		peek(void) { return -1; }
+	using Print::write;
+	size_t	write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+	size_t	write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+	void	flush(void) { fflush(stdout); }
+	operator bool() { return true; }
+};
+
+#endif	/* __HOST_SOFTWARESERIAL_H__ */
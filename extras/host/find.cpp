@@ -0,0 +1,127 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	Microbenchmark of the response term matching. It feeds the typical
+	receiving stream to the automaton of _findStep, and to the walk of
+	each term per a byte which the response method used before it, and
+	reports the bytes per second of both with the detected terms.
+	The walk keeps the partial match over the mismatched characters as
+	the response method did, so its count of the terms differs from the
+	automaton by the false and the missed detections.
+
+	Options
+		-m <bytes>		Size of the stream to be fed, 1 MB by default
+		-r <count>		Number of the rounds, 20 by default
+*/
+
+#include <chrono>
+#include <string>
+#include <unistd.h>
+#include "ESP8266.h"
+
+using namespace ESP8266Detail;
+
+// The walk reads the terms at the run time.
+constexpr const char	*_FindSpec::term[];
+
+// The table walk of each term, the state is the matched length.
+static uint8_t	_walk[_FIND_TERMS];
+
+static WIFI_ERR _walkStep(uint8_t c) {
+	uint8_t		t, u, state;
+
+	for (t = 0; t < _FIND_TERMS; t++) {
+		state = _walk[t];
+		if ((char)c == _FindSpec::term[t][state]) {
+			if (_FindSpec::term[t][++state] == '\0') {
+				for (u = 0; u < _FIND_TERMS; u++)
+					_walk[u] = 0;
+				return (WIFI_ERR)(int8_t)pgm_read_byte(&_FIND_CONDITION::v[t]);
+			}
+			_walk[t] = state;
+		}
+	}
+	return WIFI_ERR_TIMEOUT;
+}
+
+/**
+ * Make the receiving stream of the replies and the received data.
+ */
+static std::string _stream(size_t size) {
+	static const char	*replies[] = {
+		"AT+CIPSTATUS\r\r\nSTATUS:3\r\n+CIPSTATUS:0,\"TCP\",\"192.168.0.10\",80,0\r\n\r\nOK\r\n",
+		"AT+CIPSEND=0,64\r\r\nOK\r\n> ",
+		"\r\nRecv 64 bytes\r\n\r\nSEND OK\r\n",
+		"\r\n+IPD,0,64:",
+		"1,CONNECT\r\n",
+		"busy p...\r\n",
+		"\n\nOK\r\n",
+		"1,CLOSED\r\n",
+		"AT+CIPSTART=1,\"TCP\",\"192.168.0.10\",80\r\r\n1,CONNECT\r\n\r\nOK\r\n"
+	};
+	std::string	s;
+	uint32_t	seed = 1;
+
+	while (s.size() < size) {
+		for (size_t i = 0; i < sizeof(replies) / sizeof(replies[0]); i++) {
+			s += replies[i];
+			// The payload of +IPD is the arbitrary binary.
+			if (i == 3)
+				for (uint8_t n = 0; n < 64; n++) {
+					seed = seed * 1103515245 + 12345;
+					s += (char)(seed >> 16);
+				}
+		}
+	}
+	return s;
+}
+
+/**
+ * Feed the stream by the rounds and measure the elapsed time.
+ * @return		Bytes per second
+ */
+template<class F>
+static double _measure(const std::string &s, int rounds, F step, uint32_t &found) {
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+	double		elapsed;
+
+	found = 0;
+	for (int r = 0; r < rounds; r++)
+		for (size_t i = 0; i < s.size(); i++)
+			if (step((uint8_t)s[i]) != WIFI_ERR_TIMEOUT)
+				found++;
+	elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	found /= rounds;
+	return elapsed > 0 ? s.size() * (double)rounds / elapsed : 0;
+}
+
+int main(int argc, char **argv) {
+	size_t		size = 1 << 20;
+	int			rounds = 20, opt;
+	uint8_t		state = 0;
+	uint32_t	foundDfa, foundWalk;
+	double		dfa, walk;
+	std::string	s;
+
+	while ((opt = getopt(argc, argv, "m:r:")) != -1) {
+		switch (opt) {
+		case 'm': size = (size_t)atol(optarg); break;
+		case 'r': rounds = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-m bytes] [-r rounds]\n", argv[0]);
+			return 2;
+		}
+	}
+	s = _stream(size);
+	dfa = _measure(s, rounds, [&state](uint8_t c) { return _findStep(state, c); }, foundDfa);
+	walk = _measure(s, rounds, _walkStep, foundWalk);
+	printf("stream: %zu bytes x %d rounds, %u states, %u edges\n", s.size(), rounds, _FIND_STATES, _findEdgeAt(_FIND_STATES));
+	printf("automaton: %12.0f bytes/s, %u terms detected\n", dfa, foundDfa);
+	printf("table walk: %11.0f bytes/s, %u terms detected\n", walk, foundWalk);
+	printf("ratio: %.2f\n", walk > 0 ? dfa / walk : 0);
+	return 0;
+}
@@ -0,0 +1,863 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	Scenarios of the library against the simulated ESP8266. Each scenario
+	powers on the module, drives WiFi through the public methods and
+	checks the results along with the commands which the module received.
+	The servers are on the loopback interface, and the time is virtual,
+	so the scenario of the long time-out finishes at once.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "ESP8266.h"
+#include "ESP8266Http.h"
+#include "ESP8266Trace.h"
+#include "EspSim.h"
+#include "Loopback.h"
+
+#define SSID		"WARPSTAR-9FD487-G"
+#define PWD			"BC5457B5C4E0A"
+#define HOST		"192.168.0.10"
+#define ECHO_PORT	7
+#define HTTP_PORT	80
+#define SERVER_PORT	8080
+
+static EspSim		_sim;
+static LoopbackEcho	_echo;
+static LoopbackEcho	_udpEcho(true);
+static LoopbackHttp	_http;
+static uint16_t		_failures;
+static uint16_t		_checks;
+
+// Record the failed condition with the line.
+#define EXPECT(cond)	_expect((cond), #cond, __LINE__)
+
+static void _expect(bool passed, const char *cond, int line) {
+	_checks++;
+	if (!passed) {
+		_failures++;
+		printf("  FAILED line %d: %s\n", line, cond);
+	}
+}
+
+/**
+ * Power on the module with the loopback servers, and restart WiFi at the
+ * boot rate of the module.
+ * @parameter	config	Configuration of the module
+ * @return		true if the module got ready
+ */
+static bool _power(const EspSimConfig &config = EspSimConfig()) {
+	_sim.begin(config);
+	_sim.route(HOST, ECHO_PORT, _echo.port());
+	_sim.route(HOST, HTTP_PORT, _http.port());
+	_sim.route("udp.example.com", ECHO_PORT, _udpEcho.port());
+	_sim.route("www.example.com", HTTP_PORT, _http.port());
+	_sim.poll([]() {
+		_echo.poll();
+		_udpEcho.poll();
+		_http.poll();
+	});
+	return WiFi.reset(WIFI_RESET_HARD) && WiFi.begin(config.baudrate);
+}
+
+/**
+ * Count the commands which begin with the prefix.
+ */
+static uint16_t _issued(const char *prefix) {
+	const std::vector<std::string>	&log = _sim.commands();
+	uint16_t	count = 0;
+
+	for (size_t i = 0; i < log.size(); i++)
+		if (!log[i].compare(0, strlen(prefix), prefix))
+			count++;
+	return count;
+}
+
+/**
+ * Receive the length from the connection until the time-out.
+ */
+static std::string _receive(int8_t channel, uint16_t length, uint32_t timeOut = 3000) {
+	uint8_t		buffer[32];
+	uint32_t	startAt = millis();
+	std::string	data;
+	int16_t		n;
+
+	while (data.size() < length && millis() - startAt < timeOut)
+		if ((n = WiFi.read(channel, buffer, sizeof(buffer))) > 0)
+			data.append((const char *)buffer, (size_t)n);
+	return data;
+}
+
+// Join the access point and inquire the station.
+static void joinStation(void) {
+	char	ap[ESP8266_SSID_SIZE];
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_SINGLE) == WIFI_ERR_OK);
+	EXPECT(!WiFi.isConnect(ap));
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(_sim.joined());
+	EXPECT(WiFi.isConnect(ap) && !strcmp(ap, SSID));
+	EXPECT(!strcmp(WiFi.ip(WIFI_MODE_STA), "192.168.0.20"));
+	EXPECT(WiFi.status() == WIFI_STATUS_GOTIP);
+	EXPECT(WiFi.disconnect() == WIFI_ERR_OK);
+	EXPECT(!_sim.joined());
+}
+
+// The setup commands are pipelined, and the one answered busy is issued again.
+static void pipelineSetup(void) {
+	static bool	answered;
+	WIFI_HANDLE	join, closing;
+
+	EXPECT(_power());
+	answered = false;
+	_sim.script([](EspSim &sim, const std::string &line) {
+		if (!line.compare(0, 10, "AT+CIPMUX=") && !answered) {
+			answered = true;
+			sim.reply("busy p...\r\n");
+			return true;
+		}
+		return false;
+	});
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(answered && _issued("AT+CIPMUX=") == 2);
+	EXPECT(_issued("AT+CWMODE") == 1);
+	// Nothing to close behind the join concludes without its reply.
+	WiFi.pipeline(2);
+	join = WiFi.joinAsync(SSID, PWD);
+	closing = WiFi.closeAsync();
+	EXPECT(WiFi.result(closing) == WIFI_ERR_OK);
+	EXPECT(WiFi.result(join) == WIFI_ERR_PENDING);
+	EXPECT(WiFi.wait(join) == WIFI_ERR_OK && _sim.joined());
+	WiFi.pipeline(1);
+	EXPECT(WiFi.connect(1, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	WiFi.close(1);
+}
+
+// Raise the baud rate over the noisy line, both ends agree on the rate.
+static void negotiateBaudrate(void) {
+	EspSimConfig	config;
+	WIFI_LINKSTAT	link;
+
+	config.reliableBaud = 230400;
+	config.noise = 100;
+	EXPECT(_power(config));
+	EXPECT(WiFi.autobaud() >= 230400);
+	link = WiFi.linkStat();
+	EXPECT(link.baudrate == _sim.baudrate());
+	EXPECT(link.probes > link.errors);
+	EXPECT(WiFi.status() != WIFI_STATUS_UNKNOWN);
+}
+
+// Exchange the data with the echo server over the multiple connection.
+static void echoStream(void) {
+	const char	*hello = "hello, loopback";
+	uint8_t		large[1500];
+
+	for (uint16_t i = 0; i < sizeof(large); i++)
+		large[i] = (uint8_t)('a' + i % 26);
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.connect(1, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	EXPECT(WiFi.connect(3, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	EXPECT(WiFi.send(1, (const uint8_t *)hello) == WIFI_ERR_OK);
+	EXPECT(_receive(1, strlen(hello)) == hello);
+	EXPECT(WiFi.send(3, large, sizeof(large)) == WIFI_ERR_OK);
+	EXPECT(_receive(3, sizeof(large)) == std::string((const char *)large, sizeof(large)));
+	WiFi.close(1);
+	WiFi.close(3);
+	EXPECT(!_sim.linked(1) && !_sim.linked(3));
+	EXPECT(WiFi.connect(2, (char *)HOST, 1) != WIFI_ERR_CONNECT);
+}
+
+// Send the stream longer than a CIPSEND, the underrun aborts the link.
+static uint32_t	_produceEnd;
+
+static uint16_t _produce(uint8_t *buffer, uint16_t size, uint32_t offset) {
+	uint16_t	n;
+
+	for (n = 0; n < size && offset + n < _produceEnd; n++)
+		buffer[n] = (uint8_t)('a' + (offset + n) % 26);
+	return n;
+}
+
+static void streamLarge(void) {
+	WIFI_STREAMSTAT	stat;
+	std::string	expected, echo;
+	uint8_t		buffer[64];
+	int16_t		n;
+
+	for (uint16_t i = 0; i < 3000; i++)
+		expected += (char)('a' + i % 26);
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	// The module holds the echo until it is pulled.
+	EXPECT(WiFi.passive(true) == WIFI_ERR_OK);
+	EXPECT(WiFi.connect(1, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	_produceEnd = 3000;
+	EXPECT(WiFi.sendStream(1, 3000, _produce) == WIFI_ERR_OK);
+	stat = WiFi.streamStat();
+	EXPECT(stat.segments == 2 && stat.sent == 3000 && _issued("AT+CIPSEND=") == 2);
+	EXPECT(stat.elapsed && stat.throughput == (uint32_t)((uint64_t)stat.sent * 1000 / stat.elapsed));
+	while (echo.size() < expected.size() && (n = WiFi.receive(1, buffer, sizeof(buffer), 1000)) > 0)
+		echo.append((const char *)buffer, (size_t)n);
+	EXPECT(echo == expected);
+	// The producer runs dry in the second segment.
+	_produceEnd = 2500;
+	EXPECT(WiFi.sendStream(1, 3000, _produce) == WIFI_ERR_ERROR);
+	stat = WiFi.streamStat();
+	EXPECT(stat.segments == 2 && stat.sent == 2048);
+	EXPECT(_issued("AT+CIPCLOSE=1") == 1 && !_sim.linked(1));
+}
+
+// Gather the binary segments in RAM and PROGMEM which contain NUL.
+static const uint8_t	_blob[] PROGMEM = { 0x00, 0xff, 0x00, 0x0d, 0x0a, 'O', 'K', 0x00, 0x80, 0x00 };
+
+static void gatherBinary(void) {
+	static uint8_t	large[2100];
+	const uint8_t	head[] = { 'B', 0x00, 'N' };
+	WIFI_SEGMENT	segment[3];
+	std::string		expected, echo;
+	uint8_t			buffer[64];
+	int16_t			n;
+
+	for (uint16_t i = 0; i < sizeof(large); i++)
+		large[i] = (uint8_t)(i % 7 ? i : 0);
+	segment[0].data = head;
+	segment[0].length = sizeof(head);
+	segment[0].progmem = false;
+	segment[1].data = _blob;
+	segment[1].length = sizeof(_blob);
+	segment[1].progmem = true;
+	segment[2].data = large;
+	segment[2].length = 100;
+	segment[2].progmem = false;
+	expected.assign((const char *)head, sizeof(head));
+	expected.append((const char *)_blob, sizeof(_blob));
+	expected.append((const char *)large, 100);
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.passive(true) == WIFI_ERR_OK);
+	EXPECT(WiFi.connect(1, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	EXPECT(WiFi.send(1, segment, 3) == WIFI_ERR_OK);
+	EXPECT(_issued("AT+CIPSEND=1,113") == 1);
+	// The segments longer than a CIPSEND are split across them.
+	segment[2].length = sizeof(large);
+	expected.append((const char *)head, sizeof(head));
+	expected.append((const char *)_blob, sizeof(_blob));
+	expected.append((const char *)large, sizeof(large));
+	EXPECT(WiFi.sendStream(1, segment, 3) == WIFI_ERR_OK);
+	EXPECT(WiFi.streamStat().segments == 2);
+	while (echo.size() < expected.size() && (n = WiFi.receive(1, buffer, sizeof(buffer), 1000)) > 0)
+		echo.append((const char *)buffer, (size_t)n);
+	EXPECT(echo == expected);
+	WiFi.close(1);
+}
+
+// The other connection closed during close keeps the pool in sync.
+static void closeOther(void) {
+	int8_t	first, second, again;
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	first = WiFi.acquire(HOST, ECHO_PORT);
+	second = WiFi.acquire(HOST, ECHO_PORT);
+	EXPECT(first == 0 && second == 1);
+	WiFi.release(first);
+	// "0,CLOSED" arrives in front of the reply of AT+CIPCLOSE=1.
+	_sim.script([](EspSim &sim, const std::string &line) {
+		if (line == "AT+CIPCLOSE=1")
+			sim.hangup(0);
+		return false;
+	});
+	WiFi.close(second);
+	EXPECT(!_sim.linked(0) && !_sim.linked(1));
+	again = WiFi.acquire(HOST, ECHO_PORT);
+	EXPECT(again >= 0 && _sim.linked(again));
+	EXPECT(_issued("AT+CIPSTART=") == 3);
+	EXPECT(WiFi.send(again, (const uint8_t *)"again") == WIFI_ERR_OK);
+	WiFi.close(again);
+}
+
+// The pool passes over the connection made by connect.
+static void poolBesidePlain(void) {
+	int8_t	pooled;
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.connect(0, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	pooled = WiFi.acquire(HOST, ECHO_PORT);
+	EXPECT(pooled == 1);
+	WiFi.release(pooled);
+	// The failed connect leaves the idle one and the plain one.
+	EXPECT(WiFi.acquire(HOST, 1) < 0);
+	EXPECT(WiFi.acquire(HOST, ECHO_PORT) == pooled);
+	EXPECT(WiFi.send(0, (const uint8_t *)"plain") == WIFI_ERR_OK);
+	EXPECT(_receive(0, 5) == "plain");
+	WiFi.close(0);
+	WiFi.close(pooled);
+	EXPECT(!_sim.linked(0) && !_sim.linked(1));
+}
+
+// The resolution cache keeps its entries over the failures not of them.
+static void cacheResolution(void) {
+	const char	*hosts[] = { "a.example.com", "b.example.com", "c.example.com", "d.example.com" };
+	uint16_t	invalidated;
+
+	EXPECT(_power());
+	for (uint8_t i = 0; i < 4; i++)
+		_sim.route(hosts[i], ECHO_PORT, _echo.port());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	WiFi.invalidate(NULL);
+	for (uint8_t i = 0; i < 4; i++)
+		EXPECT(WiFi.resolve(hosts[i]) != NULL);
+	// The failed resolution replaces no entry.
+	EXPECT(WiFi.resolve("unknown.example.com") == NULL);
+	for (uint8_t i = 0; i < 4; i++)
+		EXPECT(WiFi.resolve(hosts[i]) != NULL);
+	EXPECT(_issued("AT+CIPDOMAIN=") == 5);
+	// ALREADY CONNECTED is not the fault of the address.
+	invalidated = WiFi.dnsStat().invalidated;
+	EXPECT(WiFi.connect(1, (char *)hosts[0], ECHO_PORT) == WIFI_ERR_CONNECT);
+	EXPECT(WiFi.connect(1, (char *)hosts[0], ECHO_PORT) != WIFI_ERR_CONNECT);
+	EXPECT(WiFi.dnsStat().invalidated == invalidated);
+	EXPECT(WiFi.resolve(hosts[0]) != NULL && _issued("AT+CIPDOMAIN=") == 5);
+	// The address which refused the connect is dropped.
+	EXPECT(WiFi.connect(2, (char *)hosts[1], 1) != WIFI_ERR_CONNECT);
+	EXPECT(WiFi.dnsStat().invalidated == invalidated + 1);
+	EXPECT(WiFi.resolve(hosts[1]) != NULL && _issued("AT+CIPDOMAIN=") == 6);
+	WiFi.close(1);
+}
+
+// The drop of the station during the connect reaches autojoin.
+static void dropWhileConnect(void) {
+	uint32_t	startAt;
+	uint16_t	drops;
+	bool		learning = false;
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	WiFi.autojoin(SSID, PWD);
+	// BSSID is learned after the join without blocking maintain.
+	startAt = millis();
+	while (WiFi.maintain() != WIFI_JOIN_UP && millis() - startAt < 10000)
+		learning |= WiFi.maintain() == WIFI_JOIN_LEARNING;
+	EXPECT(WiFi.maintain() == WIFI_JOIN_UP);
+	EXPECT(learning && !strcmp(WiFi.bssid(), "aa:bb:cc:dd:ee:ff"));
+	// "WIFI DISCONNECT" ends with CONNECT, it is not the result.
+	_sim.script([](EspSim &sim, const std::string &line) {
+		if (!line.compare(0, 12, "AT+CIPSTART="))
+			sim.reply("WIFI DISCONNECT\r\n");
+		return false;
+	});
+	drops = WiFi.joinStat().drops;
+	EXPECT(WiFi.connect(1, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	EXPECT(WiFi.joinStat().drops == drops + 1);
+	WiFi.close(1);
+	WiFi.autojoin(NULL, NULL);
+}
+
+// Parse the response of the HTTP server with and without the chunk.
+static std::string	_body;
+
+static bool _collectBody(const uint8_t *data, uint16_t length) {
+	_body.append((const char *)data, length);
+	return true;
+}
+
+static void httpResponse(void) {
+	ESP8266Http	response(_collectBody);
+	const char	*get = "GET /large.bin HTTP/1.0\r\n\r\n";
+	uint32_t	startAt;
+
+	_http.content("/large.bin", 3000);
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_SINGLE) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	for (uint8_t chunked = 0; chunked < 2; chunked++) {
+		_http.chunked(chunked);
+		_body.clear();
+		response.reset();
+		EXPECT(WiFi.connect((char *)"www.example.com", HTTP_PORT) == WIFI_ERR_CONNECT);
+		EXPECT(WiFi.send((const uint8_t *)get) == WIFI_ERR_OK);
+		startAt = millis();
+		while (!response.done() && millis() - startAt < 10000UL)
+			(void)response.parse(WiFi);
+		EXPECT(response.status() == 200);
+		EXPECT(response.chunked() == (bool)chunked);
+		EXPECT(_body.size() == 3000 && _body[64] == '0');
+		WiFi.close();
+	}
+	_http.chunked(false);
+}
+
+// Send the datagrams and receive the echo with the remote end.
+static void udpDatagram(void) {
+	uint8_t		buffer[32];
+	char		host[16];
+	uint16_t	port = 0;
+	int16_t		n = 0;
+	uint32_t	startAt;
+	uint16_t	discarded;
+	WIFI_STATS	stats;
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_UDP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.bind(2, 5000) == WIFI_ERR_CONNECT);
+	EXPECT(WiFi.sendTo(2, "udp.example.com", ECHO_PORT, (const uint8_t *)"ping", 4) == WIFI_ERR_OK);
+	startAt = millis();
+	while ((n = WiFi.recvFrom(2, buffer, sizeof(buffer), host, &port)) <= 0 && millis() - startAt < 3000)
+		;
+	EXPECT(n == 4 && !memcmp(buffer, "ping", 4));
+	EXPECT(port == ECHO_PORT && !strncmp(host, "10.0.0.", 7));
+	// The datagram beyond the held frames is discarded, not merged.
+	WiFi.stats(&stats);
+	EXPECT(WiFi.sendTo(2, "udp.example.com", ECHO_PORT, (const uint8_t *)"one", 3) == WIFI_ERR_OK);
+	EXPECT(WiFi.sendTo(2, "udp.example.com", ECHO_PORT, (const uint8_t *)"two", 3) == WIFI_ERR_OK);
+	EXPECT(WiFi.sendTo(2, "udp.example.com", ECHO_PORT, (const uint8_t *)"three", 5) == WIFI_ERR_OK);
+	startAt = millis();
+	while (millis() - startAt < 500)
+		(void)WiFi.poll();
+	EXPECT(WiFi.recvFrom(2, buffer, sizeof(buffer), host, &port) == 3 && !memcmp(buffer, "one", 3));
+	EXPECT(WiFi.recvFrom(2, buffer, sizeof(buffer), host, &port) == 3 && !memcmp(buffer, "two", 3));
+	EXPECT(WiFi.recvFrom(2, buffer, sizeof(buffer), host, &port) == 0);
+	discarded = stats.discarded;
+	WiFi.stats(&stats);
+	EXPECT(stats.discarded == discarded + 1);
+	WiFi.close(2);
+}
+
+// The frame broken by the overrun of the serial is invalidated.
+static void invalidateOverrun(void) {
+	uint8_t			binary[48], buffer[64];
+	WIFI_DATAGRAM	datagram[2];
+	WIFI_UARTSTAT	before, after;
+	uint32_t		startAt;
+	int16_t			n;
+
+	for (uint8_t i = 0; i < sizeof(binary); i++)
+		binary[i] = (uint8_t)(0x80 + i);
+	datagram[0].host = datagram[1].host = "udp.example.com";
+	datagram[0].port = datagram[1].port = ECHO_PORT;
+	datagram[0].data = datagram[1].data = binary;
+	datagram[0].length = datagram[1].length = sizeof(binary);
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_UDP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.bind(2, 5000) == WIFI_ERR_CONNECT);
+	before = WiFi.uartStat();
+	// The echoes overflow the serial while the sketch is away.
+	EXPECT(WiFi.sendTo(2, datagram, 2) == 2);
+	delay(50);
+	startAt = millis();
+	while (millis() - startAt < 100)
+		(void)WiFi.poll();
+	EXPECT(Serial.overruns() > 0);
+	// The frame short of the lost bytes is found by the reply of the
+	// next command which it took in, and the following datagram is
+	// received intact.
+	EXPECT(WiFi.sendTo(2, "udp.example.com", ECHO_PORT, (const uint8_t *)"ping", 4) == WIFI_ERR_OK);
+	after = WiFi.uartStat();
+	EXPECT(after.overruns > before.overruns && after.invalidated > before.invalidated);
+	// Only the intact datagram remains, up to the receiving buffer.
+	startAt = millis();
+	while ((n = WiFi.recvFrom(2, buffer, sizeof(buffer), NULL, NULL)) <= 0 || memcmp(buffer, "ping", 4)) {
+		if (n > 0)
+			EXPECT(!memcmp(buffer, binary, n));
+		if (millis() - startAt >= 3000)
+			break;
+	}
+	EXPECT(n == 4 && !memcmp(buffer, "ping", 4));
+	WiFi.close(2);
+}
+
+// The full connection buffer pauses the module by RTS along with the
+// asynchronous command, and the blocking command is never held.
+struct FlowPolicy : public ESP8266Policy {
+	static const int8_t	rtsPin = 9;			// Arduino pin to CTS of ESP8266
+};
+
+static void pauseDuringCommand(void) {
+	ESP8266Driver<HardwareSerial, FlowPolicy>	flow(Serial);
+	EspSimConfig	config;
+	uint8_t		data[256], buffer[8];
+	WIFI_HANDLE	handle = WIFI_HANDLE_NONE;
+	WIFI_STATS	stats;
+	std::string	sent, echo;
+	uint16_t	pauses;
+	bool		paused = false;
+	uint32_t	startAt;
+	int16_t		n;
+
+	for (uint16_t i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t)('a' + i % 26);
+	config.rtsPin = FlowPolicy::rtsPin;
+	EXPECT(_power(config));
+	EXPECT(flow.begin(config.baudrate));
+	EXPECT(flow.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(flow.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(flow.connect(1, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	// The echo of each send arrives during the next one, and the
+	// sketch reads it slower than the line.
+	pauses = flow.uartStat().pauses;
+	startAt = millis();
+	while (echo.size() < 4 * sizeof(data) && millis() - startAt < 10000) {
+		if (sent.size() < 4 * sizeof(data) && flow.result(handle) != WIFI_ERR_PENDING) {
+			EXPECT((handle = flow.sendAsync(1, data, sizeof(data))) != WIFI_HANDLE_NONE);
+			sent.append((const char *)data, sizeof(data));
+		}
+		paused |= flow.result(handle) == WIFI_ERR_PENDING && flow.uartStat().pauses > pauses;
+		delay(1);
+		if ((n = flow.read(1, buffer, sizeof(buffer))) > 0)
+			echo.append((const char *)buffer, (size_t)n);
+	}
+	EXPECT(paused);
+	EXPECT(echo == sent);
+	flow.stats(&stats);
+	EXPECT(stats.dropped == 0);
+	// The blocking command concludes over the full buffer.
+	EXPECT(flow.send(1, data, sizeof(data)) == WIFI_ERR_OK);
+	EXPECT(flow.send(1, data, sizeof(data)) == WIFI_ERR_OK);
+	flow.close(1);
+	EXPECT(!_sim.linked(1));
+}
+
+// Pull the data held by the module in the passive mode.
+static void passiveReceive(void) {
+	const char	*data = "passive data over the loopback";
+	uint8_t		buffer[64];
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.passive(true) == WIFI_ERR_OK);
+	EXPECT(WiFi.connect(0, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	EXPECT(WiFi.send(0, (const uint8_t *)data) == WIFI_ERR_OK);
+	EXPECT(WiFi.receive(0, buffer, sizeof(buffer)) == (int16_t)strlen(data));
+	EXPECT(!memcmp(buffer, data, strlen(data)));
+	EXPECT(_issued("AT+CIPRECVDATA=") > 0);
+	WiFi.close(0);
+}
+
+/**
+ * Connect to the server of the module from the host.
+ * @return		Socket, -1 if failed
+ */
+static int _dial(uint16_t port) {
+	sockaddr_in	addr;
+	int			fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0 && connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+// Accept the clients connecting to the server.
+static int8_t	_accepted = -1;
+static uint16_t	_arrived;
+
+static void _onConnect(int8_t channel) {
+	_accepted = channel;
+}
+
+static void _onData(int8_t channel, uint16_t length) {
+	uint8_t	buffer[32];
+
+	_arrived += WiFi.read(channel, buffer, sizeof(buffer));
+}
+
+static void serverAccept(void) {
+	int			fd;
+	uint32_t	startAt;
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_SERVER, WIFI_PRO_TCP) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.server(SERVER_PORT) == WIFI_ERR_OK);
+	WiFi.onConnect(_onConnect);
+	WiFi.onData(_onData);
+	fd = _dial(SERVER_PORT);
+	EXPECT(fd >= 0);
+	EXPECT(send(fd, "client", 6, 0) == 6);
+	startAt = millis();
+	while ((_accepted < 0 || _arrived < 6) && millis() - startAt < 3000)
+		WiFi.serve();
+	EXPECT(_accepted == 0);
+	EXPECT(_arrived == 6);
+	close(fd);
+	WiFi.onConnect(NULL);
+	WiFi.onData(NULL);
+}
+
+// Capture the link and replay it without the module.
+struct TraceSink : public Print {
+	std::string	data;						// Captured trace
+	size_t	write(uint8_t c) { data += (char)c; return 1; }
+};
+static uint32_t	_ticks;
+
+static uint32_t _tick(void) {
+	_ticks++;
+	return (uint32_t)Host::now();
+}
+
+static void replayTrace(void) {
+	ESP8266Trace<HardwareSerial>	trace(Serial);
+	ESP8266Traced	traced(trace);
+	TraceSink		sink;
+	WIFI_STATUS		status;
+	WIFI_REPLAYSTAT	stat;
+
+	EXPECT(_power());
+	trace.start(sink);
+	EXPECT(traced.begin(115200));
+	status = traced.status();
+	trace.stop();
+	EXPECT(status == WIFI_STATUS_NOTCONN);
+	// Without waiting and without the clock, no time is taken.
+	{
+		ESP8266Replay	replay((const uint8_t *)sink.data.data(), sink.data.size(), 0);
+		ESP8266Replayed	replayed(replay);
+
+		EXPECT(replayed.begin(115200));
+		EXPECT(replayed.status() == status);
+		EXPECT(replay.done());
+		stat = replay.stat();
+		EXPECT(stat.mismatches == 0 && stat.elapsed == 0);
+	}
+	// The recorded timing follows the given clock.
+	{
+		ESP8266Replay	replay((const uint8_t *)sink.data.data(), sink.data.size(), 1, _tick);
+		ESP8266Replayed	replayed(replay);
+
+		_ticks = 0;
+		EXPECT(replayed.begin(115200));
+		EXPECT(replayed.status() == status);
+		EXPECT(replay.stat().mismatches == 0);
+		EXPECT(_ticks > 0);
+	}
+}
+
+// The tap keeps the records of the level and the direction, and drains
+// them with the header.
+struct TapPolicy : public ESP8266Policy {
+	static void	tap(WIFI_TAP dir, WIFI_TAPLV level, const uint8_t *data, uint16_t length) {
+		ESP8266Tap::put(dir, level, data, length);
+	}
+};
+
+static void tapRecords(void) {
+	ESP8266Driver<HardwareSerial, TapPolicy>	tapped(Serial);
+	uint8_t		fill[ESP8266_TAP_SIZE];
+	TraceSink	sink;
+	WIFI_TAPSTAT	stat;
+
+	memset(fill, '.', sizeof(fill));
+	EXPECT(_power());
+	EXPECT(tapped.begin(_sim.baudrate()));
+	ESP8266Tap::clear();
+	ESP8266Tap::level(WIFI_TAPLV_TRACE);
+	ESP8266Tap::filter(WIFI_TAP_TX | WIFI_TAP_EVENT);
+	EXPECT(tapped.status() != WIFI_STATUS_UNKNOWN);
+	ESP8266Tap::drain(sink, 0xffff);
+	EXPECT(!sink.data.compare(0, 18, "[T3]AT+CIPSTATUS\r\n"));
+	EXPECT(sink.data.find("[E2]#") != std::string::npos);
+	EXPECT(sink.data.find("[R") == std::string::npos);
+	// Only the failed command is tapped at the error level.
+	ESP8266Tap::level(WIFI_TAPLV_ERROR);
+	EXPECT(tapped.setup(WIFI_CONN_CLIENT, WIFI_PRO_TCP, WIFI_MUX_MULTI) == WIFI_ERR_OK);
+	EXPECT(tapped.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(tapped.connect(1, (char *)HOST, 1) != WIFI_ERR_CONNECT);
+	sink.data.clear();
+	ESP8266Tap::drain(sink, 0xffff);
+	EXPECT(!sink.data.compare(0, 5, "[E1]#") && sink.data.find('[', 1) == std::string::npos);
+	// The record which does not fit with its header is dropped entirely,
+	// and the filtered direction is not counted.
+	stat = ESP8266Tap::stat();
+	ESP8266Tap::put(WIFI_TAP_EVENT, WIFI_TAPLV_ERROR, fill, sizeof(fill));
+	ESP8266Tap::put(WIFI_TAP_RX, WIFI_TAPLV_ERROR, fill, 1);
+	EXPECT(ESP8266Tap::stat().dropped == stat.dropped + sizeof(fill));
+	EXPECT(ESP8266Tap::stat().tapped == stat.tapped);
+	// The records of a header are joined, and the limit keeps the rest.
+	ESP8266Tap::put(WIFI_TAP_TX, WIFI_TAPLV_ERROR, (const uint8_t *)"abc", 3);
+	ESP8266Tap::put(WIFI_TAP_TX, WIFI_TAPLV_ERROR, (const uint8_t *)"def", 3);
+	sink.data.clear();
+	ESP8266Tap::drain(sink, 6);
+	EXPECT(sink.data == "[T1]ab");
+	ESP8266Tap::drain(sink, 0xffff);
+	EXPECT(sink.data == "[T1]abcdef");
+	stat = ESP8266Tap::stat();
+	EXPECT(stat.tapped == stat.drained && stat.peak <= ESP8266_TAP_SIZE);
+	ESP8266Tap::level(WIFI_TAPLV_TRACE);
+	ESP8266Tap::filter(WIFI_TAP_RX | WIFI_TAP_EVENT);
+	ESP8266Tap::clear();
+}
+
+// The scan keeps the strongest entries which pass the filter, and parses
+// the full line of the firmware without AT+CWLAPOPT.
+static void _accessPoints(void) {
+	static const EspSimAP	aps[] = {
+		{ WIFI_ECN_OPEN, "cafe", -70, "02:00:00:00:00:01", 1 },
+		{ WIFI_ECN_WPA2_PSK, "home", -40, "02:00:00:00:00:02", 6 },
+		{ WIFI_ECN_WEP, "weak", -90, "02:00:00:00:00:03", 6 },
+		{ WIFI_ECN_WPA_WPA2_PSK, "lab", -55, "02:00:00:00:00:04", 11 },
+		{ WIFI_ECN_WPA2_PSK, "home", -80, "02:00:00:00:00:05", 11 }
+	};
+
+	for (size_t i = 0; i < sizeof(aps) / sizeof(aps[0]); i++)
+		_sim.accessPoint(aps[i]);
+}
+
+static void scanFilter(void) {
+	WIFI_AP		list[8];
+	WIFI_SCANFILTER	filter;
+
+	EXPECT(_power());
+	_accessPoints();
+	EXPECT(WiFi.scan(list, 3) == 3);
+	EXPECT(!strcmp(list[0].ssid, "home") && list[0].rssi == -40 && list[0].channel == 6);
+	EXPECT(!strcmp(list[1].ssid, "lab") && list[1].rssi == -55 && list[1].ecn == WIFI_ECN_WPA_WPA2_PSK);
+	EXPECT(!strcmp(list[2].ssid, "cafe") && list[2].rssi == -70 && list[2].channel == 1);
+	memset(&filter, 0, sizeof(filter));
+	filter.ssid = "home";
+	EXPECT(WiFi.scan(list, 8, &filter) == 2);
+	EXPECT(list[0].rssi == -40 && list[1].rssi == -80 && _issued("AT+CWLAP=\"home\"") == 1);
+	memset(&filter, 0, sizeof(filter));
+	filter.ecnMask = 1 << WIFI_ECN_OPEN | 1 << WIFI_ECN_WEP;
+	EXPECT(WiFi.scan(list, 8, &filter) == 2);
+	EXPECT(!strcmp(list[0].ssid, "cafe") && !strcmp(list[1].ssid, "weak"));
+	memset(&filter, 0, sizeof(filter));
+	filter.channel = 11;
+	filter.minRssi = -60;
+	EXPECT(WiFi.scan(list, 8, &filter) == 1 && !strcmp(list[0].ssid, "lab"));
+	EXPECT(_issued("AT+CWLAPOPT=1,23") == 1);
+	// The firmware without AT+CWLAPOPT reports the MAC before the channel.
+	EXPECT(_power());
+	_accessPoints();
+	_sim.script([](EspSim &sim, const std::string &line) {
+		if (!line.compare(0, 12, "AT+CWLAPOPT=")) {
+			sim.reply("\r\nERROR\r\n");
+			return true;
+		}
+		return false;
+	});
+	EXPECT(WiFi.scan(list, 8) == 5);
+	EXPECT(list[0].rssi == -40 && list[0].channel == 6 && list[4].rssi == -90 && list[4].channel == 6);
+	EXPECT(!strcmp(list[1].ssid, "lab") && list[1].channel == 11);
+	EXPECT(WiFi.scan(list, 8) == 5 && _issued("AT+CWLAPOPT=") == 1);
+}
+
+// The client accepted during the connect is served along with it.
+static int		_client = -1;
+
+static void serveWhileConnect(void) {
+	uint32_t	startAt;
+	int			fd;
+
+	EXPECT(_power());
+	EXPECT(WiFi.setup(WIFI_CONN_PEER, WIFI_PRO_TCP) == WIFI_ERR_OK);
+	EXPECT(WiFi.join(SSID, PWD) == WIFI_ERR_OK);
+	EXPECT(WiFi.server(SERVER_PORT) == WIFI_ERR_OK);
+	_accepted = -1;
+	_arrived = 0;
+	WiFi.onConnect(_onConnect);
+	WiFi.onData(_onData);
+	// "0,CONNECT" of the client arrives while connecting ID 2.
+	_sim.script([](EspSim &sim, const std::string &line) {
+		if (!line.compare(0, 14, "AT+CIPSTART=2,"))
+			_client = _dial(SERVER_PORT);
+		return false;
+	});
+	EXPECT(WiFi.connect(2, (char *)HOST, ECHO_PORT) == WIFI_ERR_CONNECT);
+	EXPECT(_client >= 0 && _sim.linked(0));
+	EXPECT(send(_client, "client", 6, 0) == 6);
+	startAt = millis();
+	while ((_accepted < 0 || _arrived < 6) && millis() - startAt < 3000)
+		WiFi.serve();
+	EXPECT(_accepted == 0);
+	EXPECT(_arrived == 6);
+	// The echo of the connected link is not taken by the handler.
+	EXPECT(WiFi.send(2, (const uint8_t *)"peer") == WIFI_ERR_OK);
+	startAt = millis();
+	while (millis() - startAt < 500)
+		WiFi.serve();
+	EXPECT(_arrived == 6);
+	EXPECT(_receive(2, 4) == "peer");
+	// The server still accepts after the connect has concluded.
+	fd = _dial(SERVER_PORT);
+	startAt = millis();
+	while (_accepted != 1 && millis() - startAt < 3000)
+		WiFi.serve();
+	EXPECT(_accepted == 1);
+	close(fd);
+	close(_client);
+	WiFi.onConnect(NULL);
+	WiFi.onData(NULL);
+}
+
+static const struct {
+	const char	*name;
+	void		(*run)(void);
+} _scenarios[] = {
+	{ "join the station", joinStation },
+	{ "pipeline the setup", pipelineSetup },
+	{ "negotiate the baud rate", negotiateBaudrate },
+	{ "echo the stream", echoStream },
+	{ "stream beyond a CIPSEND", streamLarge },
+	{ "gather the binary segments", gatherBinary },
+	{ "close beside the other link", closeOther },
+	{ "pool beside the plain link", poolBesidePlain },
+	{ "cache the resolution", cacheResolution },
+	{ "drop during the connect", dropWhileConnect },
+	{ "parse the HTTP response", httpResponse },
+	{ "exchange the datagram", udpDatagram },
+	{ "invalidate the overrun frame", invalidateOverrun },
+	{ "pause during the command", pauseDuringCommand },
+	{ "receive in the passive mode", passiveReceive },
+	{ "accept the client", serverAccept },
+	{ "serve during the connect", serveWhileConnect },
+	{ "replay the trace", replayTrace },
+	{ "tap the records", tapRecords },
+	{ "scan with the filter", scanFilter },
+};
+
+// The scenarios which contain any of the arguments in the name run.
+int main(int argc, char **argv) {
+	uint16_t	failures;
+	int			a;
+
+	for (size_t i = 0; i < sizeof(_scenarios) / sizeof(_scenarios[0]); i++) {
+		for (a = 1; a < argc && !strstr(_scenarios[i].name, argv[a]); a++)
+			;
+		if (argc > 1 && a == argc)
+			continue;
+		failures = _failures;
+		_scenarios[i].run();
+		printf("%-32s %s\n", _scenarios[i].name, failures == _failures ? "ok" : "FAILED");
+	}
+	_sim.end();
+	printf("%u checks, %u failures\n", _checks, _failures);
+	return _failures ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+/**
+	ESP8266 WiFi-Serial bridge library for the arduino.
+	Version 0.9
+	This software is released under the MIT License (MIT).
+	http://opensource.org/licenses/mit-license.php
+	Copyright (c) 2015 hieromon@gmail.com
+
+	Runner of the example sketch on the host. It powers on the simulated
+	ESP8266 with the servers on the loopback interface which stand for
+	the hosts of the examples, and then runs setup() and loop(). The
+	sketch ends by the endless loop as on the board, the runner regards
+	it as halted when it makes no call to the core for a while, and
+	reports the statistics of the link.
+
+	Options
+		-b <baud>		Baud rate of ESP8266 at the boot
+		-r <baud>		Reliable baud rate, the noise is applied above it
+		-n <count>		Corrupted bytes per 10000 above the reliable rate
+		-l <us>			Processing time of a command
+		-L <us>			Round trip time of the network
+		-c <us>			Cost of a call to the core
+		-s <bytes>		Size of the large file of the HTTP server
+		-t <sec>		Limit of the run in seconds
+*/
+
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "Arduino.h"
+#include "EspSim.h"
+#include "Loopback.h"
+
+void	setup(void);
+void	loop(void);
+
+static EspSim		_sim;
+static LoopbackHttp	_http;
+static LoopbackSink	_sink;
+
+/**
+ * Report the statistics of the link.
+ */
+static void _report(const char *reason) {
+	EspSimStat	stat = _sim.stat();
+
+	printf("\n-- %s at %llu ms: %u commands, %u busy, %u bytes to ESP8266, %u bytes from ESP8266,"
+		" %u corrupted, %u overruns, %llu bytes to the sink\n",
+		reason, (unsigned long long)(Host::now() / 1000), stat.commands, stat.busy, stat.rxBytes, stat.txBytes,
+		stat.corrupted, Serial.overruns(), (unsigned long long)_sink.received());
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	EspSimConfig	config;
+	uint64_t		calls, limit = 600;
+	size_t			size = 65536;
+	int				opt, rounds = 0;
+
+	while ((opt = getopt(argc, argv, "b:r:n:l:L:c:s:t:")) != -1) {
+		switch (opt) {
+		case 'b': config.baudrate = (uint32_t)atol(optarg); break;
+		case 'r': config.reliableBaud = (uint32_t)atol(optarg); break;
+		case 'n': config.noise = (uint16_t)atoi(optarg); break;
+		case 'l': config.latency = (uint32_t)atol(optarg); break;
+		case 'L': config.netLatency = (uint32_t)atol(optarg); break;
+		case 'c': Host::cost((uint32_t)atol(optarg)); break;
+		case 's': size = (size_t)atol(optarg); break;
+		case 't': limit = (uint64_t)atol(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-b baud] [-r baud] [-n noise] [-l us] [-L us] [-c us] [-s bytes] [-t sec]\n", argv[0]);
+			return 2;
+		}
+	}
+	_http.content("/", "<html><body>Hello from the loopback</body></html>\r\n");
+	_http.content("/large.bin", size);
+	_sim.begin(config);
+	_sim.route("192.168.0.10", 80, _http.port());
+	_sim.route("192.168.0.10", 5001, _sink.port());
+	_sim.route("www.google.co.jp", 80, _http.port());
+	_sim.poll([]() {
+		_http.poll();
+		_sink.poll();
+	});
+
+	std::thread([]() {
+		setup();
+		for (;;)
+			loop();
+	}).detach();
+	// The sketch has halted when the calls stop growing.
+	do {
+		calls = Host::calls();
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		if (++rounds > (int)(limit * 5)) {
+			_report("time out");
+			_exit(1);
+		}
+	} while (Host::calls() != calls);
+	_report("halted");
+	_exit(0);
+}